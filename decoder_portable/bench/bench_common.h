@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Fixtures and reporting helpers shared by the benchmarks.
+
+// The first message of sample_messages.txt: a plaintext TEXT_MESSAGE from
+// !849c57c0 on ShortSlow, packet id 0x24de9f4b.
+static const char* SAMPLE_MESSAGE =
+    "0a250dc0579c8415ffffffff22050801120131354b9fde243d95846f684803586478"
+    "039801c001120953686f7274536c6f771a09213834396335376330";
+
+// fixed32 fields are little-endian on the wire
+inline std::string hex32(uint32_t value) {
+    char buffer[9];
+    snprintf(buffer, sizeof(buffer), "%02x%02x%02x%02x",
+             value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, value >> 24);
+    return buffer;
+}
+
+// SAMPLE_MESSAGE with its sender and packet id replaced.
+inline std::string sampleMessage(uint32_t from, uint32_t id) {
+    static const std::string sample = SAMPLE_MESSAGE;
+    static const size_t fromAt = sample.find("c0579c84");
+    static const size_t idAt = sample.find("4b9fde24");
+    std::string line = sample;
+    line.replace(fromAt, 8, hex32(from));
+    line.replace(idAt, 8, hex32(id));
+    return line;
+}
+
+// `count` distinct messages from the sample's sender, packet ids 1..count.
+inline std::vector<std::string> makeMessages(size_t count) {
+    std::vector<std::string> messages;
+    messages.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        messages.push_back(sampleMessage(0x849c57c0, (uint32_t)i + 1));
+    }
+    return messages;
+}
+
+// Writes one message per line, as in a capture file.
+inline void writeCapture(const std::string& path, const std::vector<std::string>& messages) {
+    std::ofstream out(path, std::ios::binary);
+    for (const std::string& line : messages) out << line << '\n';
+}
+
+inline double elapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// One line of p50/p99 query latency (microseconds) and average result count.
+inline void printLatency(const std::string& name, std::vector<double>& samples, size_t results) {
+    std::sort(samples.begin(), samples.end());
+    std::cout << std::left << std::setw(30) << name << std::right << std::fixed << std::setprecision(2)
+              << "p50 " << std::setw(8) << samples[samples.size() / 2] << " us"
+              << "   p99 " << std::setw(8) << samples[samples.size() * 99 / 100] << " us"
+              << "   avg results " << results / samples.size() << std::endl;
+}
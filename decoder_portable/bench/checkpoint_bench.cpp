@@ -0,0 +1,277 @@
+// Checkpoint benchmark: cost of periodic checkpoints on batch decoding, and
+// a crash/resume check that the resumed output is byte-identical to an
+// uninterrupted run.
+//
+//   checkpoint_bench [messages] [nodes]
+//
+// The crash is real: the bench re-runs itself as a child process that
+// decodes with checkpoints, and kills it (SIGKILL / TerminateProcess) once
+// about 60% of the output has been written. This is repeated for each I/O
+// backend, including O_DIRECT with its padded final block.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <thread>
+#include <chrono>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "../src/batch_decoder.h"
+#include "bench_common.h"
+
+using namespace std;
+
+// Sample messages from `nodes` senders. Every tenth message repeats an
+// earlier one, as when several gateways relay a packet.
+static vector<string> makeRelayedMessages(size_t count, uint32_t nodes) {
+    vector<string> messages;
+    messages.reserve(count);
+    uint32_t id = 1;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t packetId = (i % 10 == 9) ? id - 5 : id++;
+        uint32_t from = 0x10000000 + (packetId * 2654435761u) % nodes;
+        messages.push_back(sampleMessage(from, packetId));
+    }
+    return messages;
+}
+
+static string readFile(const string& path) {
+    ifstream in(path, ios::binary);
+    ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+// A copy of this program running --decode, killed without any chance to
+// flush or checkpoint.
+class ChildDecoder {
+public:
+    bool start(const string& self, const vector<string>& args) {
+#ifdef _WIN32
+        string command = "\"" + self + "\"";
+        for (const string& arg : args) command += " \"" + arg + "\"";
+        STARTUPINFOA startup;
+        ZeroMemory(&startup, sizeof(startup));
+        startup.cb = sizeof(startup);
+        ZeroMemory(&info, sizeof(info));
+        return CreateProcessA(nullptr, &command[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr,
+                              &startup, &info) != 0;
+#else
+        pid = fork();
+        if (pid < 0) return false;
+        if (pid == 0) {
+            vector<char*> argv;
+            argv.push_back(const_cast<char*>(self.c_str()));
+            for (const string& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+            argv.push_back(nullptr);
+            execv(self.c_str(), argv.data());
+            _exit(127);
+        }
+        return true;
+#endif
+    }
+
+    bool running() {
+#ifdef _WIN32
+        return WaitForSingleObject(info.hProcess, 0) == WAIT_TIMEOUT;
+#else
+        return pid > 0 && waitpid(pid, &status, WNOHANG) == 0;
+#endif
+    }
+
+    // Returns true if the child was still running when it was killed.
+    bool kill() {
+#ifdef _WIN32
+        bool killed = running() && TerminateProcess(info.hProcess, 1);
+        WaitForSingleObject(info.hProcess, INFINITE);
+        CloseHandle(info.hThread);
+        CloseHandle(info.hProcess);
+        return killed;
+#else
+        bool killed = running() && ::kill(pid, SIGKILL) == 0;
+        if (killed) waitpid(pid, &status, 0);
+        pid = -1;
+        return killed;
+#endif
+    }
+
+private:
+#ifdef _WIN32
+    PROCESS_INFORMATION info;
+#else
+    pid_t pid = -1;
+    int status = 0;
+#endif
+};
+
+static BatchReport runScenario(const string& title, BatchConfig config) {
+    BatchReport report;
+    string error;
+    if (!runBatchDecode(config, report, error)) {
+        cout << "ERROR: " << error << endl;
+    }
+    cout << "\n########## " << title << " ##########" << endl;
+    printBatchReport(cout, report);
+    return report;
+}
+
+// Child mode:
+//   checkpoint_bench --decode <input> <output> <checkpoint> <every> <backend> <direct|buffered>
+static int decodeChild(char* argv[]) {
+    BatchConfig config;
+    config.inputPath = argv[2];
+    config.outputPath = argv[3];
+    config.checkpointPath = argv[4];
+    config.checkpointEvery = strtoull(argv[5], nullptr, 10);
+    parseIoBackend(argv[6], config.io.backend);
+    config.io.direct = string(argv[7]) == "direct";
+    config.psk = getPSKFromInput("AQ==", false);
+    BatchReport report;
+    string error;
+    if (!runBatchDecode(config, report, error)) {
+        cerr << "ERROR: " << error << endl;
+        return 1;
+    }
+    return 0;
+}
+
+static const char* backendName(IoBackend backend) {
+    return backend == IoBackend::Threads ? "threads" : backend == IoBackend::Uring ? "uring" : "auto";
+}
+
+// Kills a decoding child once ~60% of the output is on disk, then resumes
+// twice: once to finish, once more to check that a finished run is a no-op.
+// Returns false if the resumed output differs from `reference`.
+static bool killAndResume(const string& self, const string& reference, BatchConfig config) {
+    string label = string(backendName(config.io.backend)) + (config.io.direct ? " O_DIRECT" : "");
+    AsyncFileReader probe;
+    string error;
+    if (!probe.open(config.inputPath, 0, config.io, error)) {
+        cout << "\n########## kill and resume, " << label << " ##########" << endl;
+        cout << "Skipped: " << error << endl;
+        return true;
+    }
+    probe.close();
+
+    std::filesystem::remove(config.checkpointPath);
+    std::filesystem::remove(config.outputPath);
+    uint64_t killAt = std::filesystem::file_size(reference) * 6 / 10;
+    ChildDecoder child;
+    if (!child.start(self, {"--decode", config.inputPath, config.outputPath, config.checkpointPath,
+                            to_string(config.checkpointEvery), backendName(config.io.backend),
+                            config.io.direct ? "direct" : "buffered"})) {
+        cout << "ERROR: cannot start the decoding child" << endl;
+        return false;
+    }
+    auto outputSize = [&] {
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(config.outputPath, ec);
+        return ec ? 0 : size;
+    };
+    while (child.running() && outputSize() < killAt) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    bool killed = child.kill();
+    uint64_t sizeAtKill = outputSize();
+    cout << "\n########## kill and resume, " << label << " ##########" << endl;
+    cout << (killed ? "Killed the decoding child at " : "Child finished before the kill, output ")
+         << sizeAtKill << " output bytes" << endl;
+
+    runScenario("resumed run, " + label, config);
+    runScenario("resumed again, " + label, config);
+
+    bool identical = readFile(config.outputPath) == readFile(reference);
+    cout << "\nResumed output " << (identical ? "matches" : "DIFFERS FROM")
+         << " the uninterrupted run" << endl;
+    return identical;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 8 && string(argv[1]) == "--decode") return decodeChild(argv);
+    size_t count = argc > 1 ? (size_t)strtoul(argv[1], nullptr, 10) : 500000;
+    uint32_t nodes = argc > 2 ? (uint32_t)strtoul(argv[2], nullptr, 10) : 2000;
+
+    string dir = std::filesystem::temp_directory_path().string() + "/checkpoint_bench";
+    std::filesystem::create_directories(dir);
+    string input = dir + "/capture.txt";
+    string checkpoint = dir + "/decode.ckpt";
+    writeCapture(input, makeRelayedMessages(count, nodes));
+
+    BatchConfig config;
+    config.inputPath = input;
+    config.psk = getPSKFromInput("AQ==", false);
+
+    cout << "Messages: " << count << ", nodes: " << nodes << endl;
+
+    config.outputPath = dir + "/reference.txt";
+    BatchReport baseline = runScenario("no checkpoints", config);
+
+    config.outputPath = dir + "/checkpointed.txt";
+    config.checkpointPath = checkpoint;
+    for (uint64_t every : {100000ull, 10000ull, 1000ull}) {
+        std::filesystem::remove(checkpoint);
+        config.checkpointEvery = every;
+        BatchReport report = runScenario("checkpoint every " + to_string(every), config);
+        cout << "Overhead vs no checkpoints: " << fixed << setprecision(1)
+             << 100.0 * ((double)report.wallNs - baseline.wallNs) / baseline.wallNs << "%" << endl;
+        cout << defaultfloat;
+    }
+
+    config.outputPath = dir + "/resumed.txt";
+    config.checkpointEvery = 7919;
+    string self = std::filesystem::absolute(argv[0]).string();
+    string reference = dir + "/reference.txt";
+    bool identical = true;
+    for (IoBackend backend : {IoBackend::Threads, IoBackend::Uring}) {
+        for (bool direct : {false, true}) {
+            config.io.backend = backend;
+            config.io.direct = direct;
+            identical = killAndResume(self, reference, config) && identical;
+        }
+    }
+
+    // A damaged checkpoint must stop the run, not restart it from record 0
+    // and truncate the output it was protecting.
+    {
+        string saved = readFile(checkpoint);
+        uint64_t outputBefore = std::filesystem::file_size(config.outputPath);
+        ofstream(checkpoint, ios::binary) << saved.substr(0, saved.size() / 2);
+        BatchReport report;
+        string error;
+        bool refused = !runBatchDecode(config, report, error) &&
+                       std::filesystem::file_size(config.outputPath) == outputBefore;
+        cout << "Resume from a truncated checkpoint: " << (refused ? "refused (" + error + ")" : "NOT REFUSED")
+             << endl;
+        identical = identical && refused;
+        ofstream(checkpoint, ios::binary) << saved;
+    }
+
+    // A checkpoint must not be applied to a different input.
+    {
+        ofstream append(input, ios::binary | ios::app);
+        append << SAMPLE_MESSAGE << '\n';
+    }
+    BatchReport report;
+    string error;
+    bool refused = !runBatchDecode(config, report, error);
+    cout << "Resume on a modified input: " << (refused ? "refused (" + error + ")" : "NOT REFUSED") << endl;
+    identical = identical && refused;
+
+    std::filesystem::remove_all(dir);
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+// Topology graph benchmark: ingest rate, CSR rebuild cost and query latency
+// on a synthetic mesh, on a prebuilt snapshot and through MeshGraph while
+// another thread keeps ingesting.
+//
+//   graph_bench [nodes] [gateways] [reports]
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+
+#include "../src/mesh_graph.h"
+#include "bench_common.h"
+
+using namespace std;
+
+// Encodes a TRACEROUTE reply from `dest` to `origin` through `route` and
+// checks that the graph links every consecutive pair.
+static bool tracerouteSmokeTest() {
+    MeshGraph graph;
+    vector<uint32_t> route = {0x2222, 0x3333};
+
+    vector<uint8_t> payload;
+    payload.push_back((uint8_t)makeTag(RouteDiscovery::ROUTE, WIRE_LENGTH_DELIMITED));
+    payload.push_back((uint8_t)(route.size() * 4));
+    for (uint32_t node : route) payload.insert(payload.end(), (uint8_t*)&node, (uint8_t*)&node + 4);
+
+    MeshPacket packet;
+    packet.from = 0x4444;  // destination answering
+    packet.to = 0x1111;    // origin
+    packet.present = fieldMask(MeshPacket::FROM, MeshPacket::TO);
+    DataMessage data;
+    data.portnum = PORT_TRACEROUTE;
+    data.payload = payload;
+    data.requestId = 7;
+    graph.observeData(packet, data, 100);
+
+    shared_ptr<const TopologySnapshot> snap = graph.snapshot(true);
+    vector<NodeDistance> near = snap->nodesWithinHops(0x1111, 3);
+    return snap->linkCount() == 3 && near.size() == 3 && snap->neighbors(0x3333).size() == 2;
+}
+
+// Queries through MeshGraph, which reads whatever snapshot the background
+// builder last published, while a second thread ingests 1000 reports every
+// 5 ms.
+static void concurrentQueries(MeshGraph& graph, const vector<uint32_t>& nodeIds,
+                              const vector<uint32_t>& gatewayIds, uint32_t time) {
+    atomic<bool> done{false};
+    thread ingest([&] {
+        mt19937 rng(7);
+        while (!done.load()) {
+            for (int i = 0; i < 1000; i++) {
+                uint32_t n = rng() % nodeIds.size();
+                graph.addReach(nodeIds[n], gatewayIds[(n / 100 + rng() % 4) % gatewayIds.size()],
+                               (uint8_t)(rng() % 4), time);
+            }
+            this_thread::sleep_for(chrono::milliseconds(5));
+        }
+    });
+
+    mt19937 rng(11);
+    const size_t queries = 10000;
+    vector<double> samples;
+    size_t results = 0;
+    size_t snapshots = 0;
+    const TopologySnapshot* last = nullptr;
+    for (size_t i = 0; i < queries; i++) {
+        uint32_t node = nodeIds[rng() % nodeIds.size()];
+        auto t = chrono::steady_clock::now();
+        results += graph.bestGateways(node, 5).size();
+        samples.push_back(elapsedUs(t));
+        const TopologySnapshot* current = graph.snapshot().get();
+        if (current != last) snapshots++;
+        last = current;
+    }
+    printLatency("bestGateways(node, 5)", samples, results);
+
+    samples.clear();
+    results = 0;
+    for (size_t i = 0; i < queries; i++) {
+        uint32_t gateway = gatewayIds[rng() % gatewayIds.size()];
+        auto t = chrono::steady_clock::now();
+        results += graph.nodesWithinHops(gateway, 2).size();
+        samples.push_back(elapsedUs(t));
+        const TopologySnapshot* current = graph.snapshot().get();
+        if (current != last) snapshots++;
+        last = current;
+    }
+    printLatency("nodesWithinHops(gw, 2)", samples, results);
+
+    done = true;
+    ingest.join();
+    cout << "Snapshots seen by the queries: " << snapshots << endl;
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t nodes = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 50000;
+    uint32_t gateways = argc > 2 ? (uint32_t)strtoul(argv[2], nullptr, 10) : 500;
+    size_t reports = argc > 3 ? (size_t)strtoul(argv[3], nullptr, 10) : 2000000;
+
+    cout << "Traceroute smoke test: " << (tracerouteSmokeTest() ? "OK" : "FAILED") << endl;
+    cout << "Nodes: " << nodes << ", gateways: " << gateways << ", reports: " << reports << endl;
+
+    mt19937 rng(42);
+    MeshGraphConfig config;
+    config.maxEdgeAge = 3600;
+    // Keep the background builder idle so the rebuilds below are timed on
+    // this thread.
+    config.maxSnapshotAgeMs = 3600 * 1000;
+    MeshGraph graph(config);
+
+    // Each node is heard by a few nearby gateways; node ids are random like
+    // real hardware ids, gateways are a subset of the nodes.
+    vector<uint32_t> nodeIds(nodes);
+    for (uint32_t& id : nodeIds) id = rng() | 0x80000000u;
+    vector<uint32_t> gatewayIds(nodeIds.begin(), nodeIds.begin() + min(gateways, nodes));
+
+    auto ingest = [&](MeshGraph& target) {
+        for (size_t i = 0; i < reports; i++) {
+            uint32_t n = rng() % nodes;
+            uint32_t g = (n / 100 + rng() % 4) % gatewayIds.size();
+            uint8_t hops = (uint8_t)(rng() % 4);
+            uint32_t time = (uint32_t)(i * 7200 / reports);  // two hours of traffic
+            target.addReach(nodeIds[n], gatewayIds[g], hops, time);
+            if (hops == 0) target.addLink(nodeIds[n], gatewayIds[g], LINK_DIRECT, time);
+            if (i % 50 == 0) {
+                target.addLink(nodeIds[n], nodeIds[(n + 1 + rng() % 20) % nodes], LINK_NEIGHBORINFO, time);
+            }
+        }
+    };
+    auto start = chrono::steady_clock::now();
+    ingest(graph);
+    double ingestUs = elapsedUs(start);
+    cout << "\nIngest: " << fixed << setprecision(1) << ingestUs / 1000 << " ms ("
+         << setprecision(0) << reports / (ingestUs / 1e6) << " reports/s)" << endl;
+
+    start = chrono::steady_clock::now();
+    shared_ptr<const TopologySnapshot> snap = graph.snapshot(true);
+    cout << "Full rebuild: " << setprecision(1) << elapsedUs(start) / 1000 << " ms ("
+         << snap->nodeCount() << " nodes, " << snap->gatewayCount() << " gateways, "
+         << snap->reachCount() << " reach edges, " << snap->linkCount() << " links after aging)" << endl;
+
+    // Incremental: a small batch folded into the compacted edge list.
+    for (size_t i = 0; i < 10000; i++) {
+        graph.addReach(nodeIds[rng() % nodes], gatewayIds[rng() % gatewayIds.size()], 1, 7200);
+    }
+    start = chrono::steady_clock::now();
+    snap = graph.snapshot(true);
+    cout << "Rebuild after 10k new reports: " << setprecision(1) << elapsedUs(start) / 1000 << " ms" << endl;
+
+    cout << "\nQueries (10000 each):" << endl;
+    const size_t queries = 10000;
+    vector<double> samples;
+    size_t results = 0;
+    for (size_t i = 0; i < queries; i++) {
+        uint32_t node = nodeIds[rng() % nodes];
+        auto t = chrono::steady_clock::now();
+        results += snap->bestGateways(node, 5).size();
+        samples.push_back(elapsedUs(t));
+    }
+    printLatency("bestGateways(node, 5)", samples, results);
+
+    for (uint32_t k = 1; k <= 3; k++) {
+        samples.clear();
+        results = 0;
+        for (size_t i = 0; i < queries; i++) {
+            uint32_t gateway = gatewayIds[rng() % gatewayIds.size()];
+            auto t = chrono::steady_clock::now();
+            results += snap->nodesWithinHops(gateway, k).size();
+            samples.push_back(elapsedUs(t));
+        }
+        printLatency("nodesWithinHops(gw, " + to_string(k) + ")", samples, results);
+    }
+
+    // The same traffic into a graph with the default rebuild interval, so
+    // the builder keeps up in the background as it would in the pipeline.
+    config.maxSnapshotAgeMs = MeshGraphConfig().maxSnapshotAgeMs;
+    MeshGraph live(config);
+    ingest(live);
+    live.snapshot(true);
+    cout << "\nQueries through MeshGraph under concurrent ingest (10000 each):" << endl;
+    concurrentQueries(live, nodeIds, gatewayIds, 7200);
+    return 0;
+}
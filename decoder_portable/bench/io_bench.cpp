@@ -0,0 +1,198 @@
+// I/O benchmark: line ingestion and summary output through iostreams versus
+// AsyncFileReader/AsyncFileWriter (io_uring, thread pool, O_DIRECT), on a
+// cold and a warm page cache, plus a full batch decode with each.
+//
+//   io_bench [messages] [block KiB]
+//
+// "Cold" drops the capture from the page cache with posix_fadvise before
+// the run (Linux only). It evicts clean pages without root, but the disk or
+// hypervisor may still cache them underneath.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+
+#include "../src/batch_decoder.h"
+#include "bench_common.h"
+
+using namespace std;
+
+static bool dropFromCache(const string& path) {
+#if defined(__linux__)
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    fdatasync(fd);
+    bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return ok;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+struct Variant {
+    string name;
+    bool iostream;
+    AsyncIoConfig io;
+};
+
+static void printRate(const string& title, uint64_t bytes, uint64_t ns, const IoStats* stats) {
+    cout << "  " << left << setw(32) << title << right << fixed << setprecision(1)
+         << setw(9) << ns / 1e6 << " ms " << setw(8) << (bytes / 1048576.0) / (ns / 1e9) << " MB/s";
+    if (stats) {
+        cout << "  (" << stats->backend << (stats->direct ? " O_DIRECT" : "")
+             << ", waited " << stats->waitNs / 1e6 << " ms)";
+    }
+    cout << defaultfloat << endl;
+}
+
+static void ingest(const Variant& variant, const string& path, bool cold) {
+    if (cold && !dropFromCache(path)) {
+        cout << "  " << variant.name << ": cold cache not available" << endl;
+        return;
+    }
+    uint64_t lines = 0;
+    uint64_t bytes = 0;
+    uint64_t start = ioNowNs();
+    string line;
+    IoStats stats;
+    if (variant.iostream) {
+        ifstream in(path, ios::binary);
+        while (getline(in, line)) {
+            lines++;
+            bytes += line.size() + 1;
+        }
+    } else {
+        AsyncFileReader reader;
+        string error;
+        if (!reader.open(path, 0, variant.io, error)) {
+            cout << "  " << variant.name << ": " << error << endl;
+            return;
+        }
+        while (reader.nextLine(line)) {
+            lines++;
+            bytes += line.size() + 1;
+        }
+        stats = reader.stats();
+    }
+    printRate(variant.name + (cold ? " (cold)" : " (warm)"), bytes, ioNowNs() - start,
+              variant.iostream ? nullptr : &stats);
+}
+
+static void emit(const Variant& variant, const string& path, const vector<string>& lines) {
+    uint64_t bytes = 0;
+    uint64_t start = ioNowNs();
+    IoStats stats;
+    if (variant.iostream) {
+        ofstream out(path, ios::binary | ios::trunc);
+        for (const string& line : lines) {
+            out << line << '\n';
+            bytes += line.size() + 1;
+        }
+    } else {
+        AsyncFileWriter writer;
+        string error;
+        if (!writer.open(path, 0, variant.io, error)) {
+            cout << "  " << variant.name << ": " << error << endl;
+            return;
+        }
+        for (const string& line : lines) {
+            writer.write(line);
+            writer.write("\n", 1);
+            bytes += line.size() + 1;
+        }
+        writer.close();
+        stats = writer.stats();
+    }
+    printRate(variant.name, bytes, ioNowNs() - start, variant.iostream ? nullptr : &stats);
+}
+
+// The decode loop as it looks on iostreams, without dedup or checkpoints.
+static void decodeWithIostreams(const string& input, const string& output, const vector<uint8_t>& psk) {
+    if (!dropFromCache(input)) cout << "  (cache not dropped)" << endl;
+    uint64_t start = ioNowNs();
+    ifstream in(input, ios::binary);
+    ofstream out(output, ios::binary | ios::trunc);
+    string line;
+    uint64_t bytes = 0;
+    while (getline(in, line)) {
+        bytes += line.size() + 1;
+        PacketRecord record;
+        record.hexInput.swap(line);
+        parseRecord(record);
+        decryptRecord(record, psk);
+        summarizeRecord(record);
+        out << record.summary << '\n';
+    }
+    out.flush();
+    printRate("iostream", bytes, ioNowNs() - start, nullptr);
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? (size_t)strtoul(argv[1], nullptr, 10) : 500000;
+    size_t blockKiB = argc > 2 ? (size_t)strtoul(argv[2], nullptr, 10) : 1024;
+
+    string dir = std::filesystem::temp_directory_path().string() + "/io_bench";
+    std::filesystem::create_directories(dir);
+    string input = dir + "/capture.txt";
+    string output = dir + "/summaries.txt";
+    writeCapture(input, makeMessages(count));
+    cout << "Messages: " << count << ", capture: "
+         << std::filesystem::file_size(input) / 1048576 << " MiB, block: " << blockKiB << " KiB" << endl;
+
+    vector<Variant> variants;
+    variants.push_back({"iostream", true, AsyncIoConfig()});
+    AsyncIoConfig io;
+    io.blockSize = blockKiB * 1024;
+    io.backend = IoBackend::Threads;
+    variants.push_back({"async threads", false, io});
+    io.backend = IoBackend::Uring;
+    variants.push_back({"async io_uring", false, io});
+    io.direct = true;
+    variants.push_back({"async io_uring O_DIRECT", false, io});
+
+    cout << "\n########## ingestion (read lines) ##########" << endl;
+    for (const Variant& variant : variants) {
+        ingest(variant, input, true);
+        ingest(variant, input, false);
+    }
+
+    cout << "\n########## output (write lines) ##########" << endl;
+    vector<string> lines;
+    {
+        ifstream in(input, ios::binary);
+        string line;
+        while (getline(in, line)) lines.push_back(line);
+    }
+    for (const Variant& variant : variants) {
+        emit(variant, output, lines);
+    }
+    lines.clear();
+
+    cout << "\n########## full decode (cold input) ##########" << endl;
+    vector<uint8_t> psk = getPSKFromInput("AQ==", false);
+    decodeWithIostreams(input, output, psk);
+    for (size_t i = 1; i < variants.size(); i++) {
+        BatchConfig config;
+        config.inputPath = input;
+        config.outputPath = output;
+        config.psk = psk;
+        config.io = variants[i].io;
+        dropFromCache(input);
+        BatchReport report;
+        string error;
+        if (!runBatchDecode(config, report, error)) {
+            cout << "  " << variants[i].name << ": " << error << endl;
+            continue;
+        }
+        printRate(variants[i].name, std::filesystem::file_size(input), report.wallNs, &report.input);
+    }
+
+    std::filesystem::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,247 @@
+#pragma once
+
+// The two hand-written parsers that mesh_proto.h replaced, kept only as a
+// throughput baseline for parser_bench. Console output has been stripped;
+// the decoding logic is otherwise unchanged.
+
+#include "../src/mesh_proto.h"
+
+namespace legacy {
+
+struct Envelope {
+    std::vector<uint8_t> packetData;
+    std::string channelId;
+    std::string gatewayId;
+    bool valid = false;
+};
+
+struct Packet {
+    uint32_t from = 0;
+    uint32_t to = 0;
+    uint64_t id = 0;
+    uint32_t channel = 0;
+    uint32_t hopLimit = 0;
+    uint32_t hopStart = 0;
+    bool wantAck = false;
+    std::vector<uint8_t> encryptedData;
+    bool valid = false;
+};
+
+// meshtastic_decoder/mqtt_decoder.cpp
+namespace decoder {
+
+inline Envelope parseServiceEnvelope(const uint8_t* data, size_t length) {
+    Envelope envelope;
+    const uint8_t* ptr = data;
+    size_t remaining = length;
+    while (remaining > 0) {
+        uint64_t fieldInfo = decodeVarint(ptr, remaining);
+        int fieldNumber = fieldInfo >> 3;
+        int wireType = fieldInfo & 0x7;
+        if (wireType == 2) {
+            uint64_t length = decodeVarint(ptr, remaining);
+            if (remaining >= length) {
+                if (fieldNumber == 1) {
+                    envelope.packetData.assign(ptr, ptr + length);
+                } else if (fieldNumber == 2) {
+                    envelope.channelId.assign((const char*)ptr, length);
+                } else if (fieldNumber == 3) {
+                    envelope.gatewayId.assign((const char*)ptr, length);
+                }
+                ptr += length;
+                remaining -= length;
+            } else {
+                break;
+            }
+        } else {
+            break;
+        }
+    }
+    envelope.valid = !envelope.packetData.empty();
+    return envelope;
+}
+
+inline Packet parseMeshPacket(const uint8_t* data, size_t length) {
+    Packet packet;
+    const uint8_t* ptr = data;
+    size_t remaining = length;
+    while (remaining > 0) {
+        uint64_t fieldInfo = decodeVarint(ptr, remaining);
+        int fieldNumber = fieldInfo >> 3;
+        int wireType = fieldInfo & 0x7;
+        switch (fieldNumber) {
+            case 1:
+                if (wireType == 0) packet.from = (uint32_t)decodeVarint(ptr, remaining);
+                break;
+            case 2:
+                if (wireType == 0) packet.to = (uint32_t)decodeVarint(ptr, remaining);
+                break;
+            case 4:
+                if (wireType == 2) {
+                    uint64_t length = decodeVarint(ptr, remaining);
+                    if (remaining >= length) {
+                        packet.encryptedData.assign(ptr, ptr + length);
+                        ptr += length;
+                        remaining -= length;
+                    }
+                }
+                break;
+            case 6:
+                if (wireType == 1) {
+                    if (remaining >= 8) {
+                        memcpy(&packet.id, ptr, 8);
+                        ptr += 8;
+                        remaining -= 8;
+                    }
+                } else if (wireType == 0) {
+                    packet.id = decodeVarint(ptr, remaining);
+                }
+                break;
+            case 7:
+                if (wireType == 0) packet.channel = (uint32_t)decodeVarint(ptr, remaining);
+                break;
+            case 8:
+                if (wireType == 0) packet.hopLimit = (uint32_t)decodeVarint(ptr, remaining);
+                break;
+            case 9:
+                if (wireType == 0) packet.hopStart = (uint32_t)decodeVarint(ptr, remaining);
+                break;
+            case 10:
+                if (wireType == 0) packet.wantAck = decodeVarint(ptr, remaining) != 0;
+                break;
+            default:
+                if (wireType == 0) {
+                    decodeVarint(ptr, remaining);
+                } else if (wireType == 2) {
+                    uint64_t length = decodeVarint(ptr, remaining);
+                    if (remaining >= length) {
+                        ptr += length;
+                        remaining -= length;
+                    }
+                } else if (wireType == 1) {
+                    if (remaining >= 8) {
+                        ptr += 8;
+                        remaining -= 8;
+                    }
+                } else if (wireType == 5) {
+                    if (remaining >= 4) {
+                        ptr += 4;
+                        remaining -= 4;
+                    }
+                }
+                break;
+        }
+    }
+    packet.valid = true;
+    return packet;
+}
+
+}  // namespace decoder
+
+// decoder_portable/src/mqtt_decoder_with_decryption.cpp
+namespace portable {
+
+inline Envelope parseServiceEnvelope(const uint8_t* data, size_t length) {
+    Envelope envelope;
+    const uint8_t* ptr = data;
+    size_t remaining = length;
+    while (remaining > 0) {
+        uint64_t tag = decodeVarint(ptr, remaining);
+        uint32_t fieldNumber = (uint32_t)(tag >> 3);
+        uint32_t wireType = tag & 0x7;
+        if (fieldNumber >= 1 && fieldNumber <= 3 && wireType == 2) {
+            uint64_t length = decodeVarint(ptr, remaining);
+            if (remaining >= length) {
+                if (fieldNumber == 1) envelope.packetData.assign(ptr, ptr + length);
+                if (fieldNumber == 2) envelope.channelId.assign((const char*)ptr, length);
+                if (fieldNumber == 3) envelope.gatewayId.assign((const char*)ptr, length);
+                ptr += length;
+                remaining -= length;
+            }
+        } else if (fieldNumber == 0 || fieldNumber > 3) {
+            if (wireType == 0) {
+                decodeVarint(ptr, remaining);
+            } else if (wireType == 2) {
+                uint64_t length = decodeVarint(ptr, remaining);
+                if (remaining >= length) {
+                    ptr += length;
+                    remaining -= length;
+                }
+            }
+        }
+    }
+    envelope.valid = !envelope.packetData.empty();
+    return envelope;
+}
+
+inline Packet parseMeshPacket(const uint8_t* data, size_t length) {
+    Packet packet;
+    const uint8_t* ptr = data;
+    size_t remaining = length;
+    while (remaining > 0) {
+        uint64_t tag = decodeVarint(ptr, remaining);
+        uint32_t fieldNumber = (uint32_t)(tag >> 3);
+        uint32_t wireType = tag & 0x7;
+        switch (fieldNumber) {
+            case 1:
+                if (wireType == 0) packet.from = (uint32_t)decodeVarint(ptr, remaining);
+                break;
+            case 2:
+                if (wireType == 0) packet.to = (uint32_t)decodeVarint(ptr, remaining);
+                break;
+            case 3:
+            case 4:
+            case 5:
+                if (wireType == 2) {
+                    uint64_t length = decodeVarint(ptr, remaining);
+                    if (remaining >= length) {
+                        packet.encryptedData.assign(ptr, ptr + length);
+                        ptr += length;
+                        remaining -= length;
+                    }
+                }
+                break;
+            case 6:
+                if (wireType == 1) {
+                    if (remaining >= 8) {
+                        memcpy(&packet.id, ptr, 8);
+                        ptr += 8;
+                        remaining -= 8;
+                    }
+                } else if (wireType == 0) {
+                    packet.id = decodeVarint(ptr, remaining);
+                }
+                break;
+            default:
+                if (wireType == 0) {
+                    decodeVarint(ptr, remaining);
+                } else if (wireType == 2) {
+                    uint64_t length = decodeVarint(ptr, remaining);
+                    if (remaining >= length) {
+                        if (length > 0 && length < 1000) {
+                            packet.encryptedData.assign(ptr, ptr + length);
+                        }
+                        ptr += length;
+                        remaining -= length;
+                    }
+                } else if (wireType == 1) {
+                    if (remaining >= 8) {
+                        ptr += 8;
+                        remaining -= 8;
+                    }
+                } else if (wireType == 5) {
+                    if (remaining >= 4) {
+                        ptr += 4;
+                        remaining -= 4;
+                    }
+                }
+                break;
+        }
+    }
+    packet.valid = true;
+    return packet;
+}
+
+}  // namespace portable
+
+}  // namespace legacy
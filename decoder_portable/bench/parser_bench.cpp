@@ -0,0 +1,125 @@
+// Parser benchmark: the schema-driven parser in mesh_proto.h against the two
+// hand-written parsers it replaced (see legacy_parsers.h).
+//
+//   parser_bench [iterations]
+//
+// Two inputs are measured: the real capture from sample_messages.txt
+// (fixed32 from/to/id, as sent by current firmware) and a message encoded
+// the way the legacy parsers expected (varint from/to, fixed64 id), so the
+// old code is timed on input it actually understands.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+
+#include "../src/pipeline.h"
+#include "legacy_parsers.h"
+#include "bench_common.h"
+
+using namespace std;
+
+static void putVarint(vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static void putBytes(vector<uint8_t>& out, uint32_t field, const void* data, size_t length) {
+    putVarint(out, makeTag(field, WIRE_LENGTH_DELIMITED));
+    putVarint(out, length);
+    const uint8_t* bytes = (const uint8_t*)data;
+    out.insert(out.end(), bytes, bytes + length);
+}
+
+static vector<uint8_t> legacyShapedMessage() {
+    vector<uint8_t> packet;
+    putVarint(packet, makeTag(1, WIRE_VARINT));
+    putVarint(packet, 0x849c57c0);
+    putVarint(packet, makeTag(2, WIRE_VARINT));
+    putVarint(packet, 0xffffffff);
+    uint8_t ciphertext[24];
+    for (size_t i = 0; i < sizeof(ciphertext); i++) ciphertext[i] = (uint8_t)(i * 37 + 11);
+    putBytes(packet, 4, ciphertext, sizeof(ciphertext));
+    uint64_t id = 0x84953d24de9f4b35ull;
+    putVarint(packet, makeTag(6, WIRE_FIXED64));
+    packet.insert(packet.end(), (uint8_t*)&id, (uint8_t*)&id + 8);
+    for (uint32_t field = 7; field <= 10; field++) {
+        putVarint(packet, makeTag(field, WIRE_VARINT));
+        putVarint(packet, field == 7 ? 8 : 3);
+    }
+
+    vector<uint8_t> envelope;
+    putBytes(envelope, 1, packet.data(), packet.size());
+    putBytes(envelope, 2, "ShortSlow", 9);
+    putBytes(envelope, 3, "!849c57c0", 9);
+    return envelope;
+}
+
+template <typename Parse>
+static void measure(const string& name, const vector<uint8_t>& message, size_t iterations, Parse parse) {
+    uint64_t checksum = 0;
+    // Warm up caches and branch predictors.
+    for (size_t i = 0; i < iterations / 10 + 1; i++) checksum += parse(message);
+
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        checksum += parse(message);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << left << setw(34) << name << right
+         << setw(10) << fixed << setprecision(1) << seconds * 1e9 / iterations << " ns/msg"
+         << setw(14) << setprecision(0) << iterations / seconds << " msg/s"
+         << "   (checksum " << checksum % 100000 << ")" << endl;
+}
+
+static void runSuite(const string& title, const vector<uint8_t>& message, size_t iterations) {
+    cout << "\n=== " << title << " (" << message.size() << " bytes) ===" << endl;
+
+    measure("legacy meshtastic_decoder", message, iterations, [](const vector<uint8_t>& m) {
+        legacy::Envelope e = legacy::decoder::parseServiceEnvelope(m.data(), m.size());
+        legacy::Packet p = legacy::decoder::parseMeshPacket(e.packetData.data(), e.packetData.size());
+        return (uint64_t)p.from + p.id + p.encryptedData.size() + e.gatewayId.size();
+    });
+
+    measure("legacy decoder_portable", message, iterations, [](const vector<uint8_t>& m) {
+        legacy::Envelope e = legacy::portable::parseServiceEnvelope(m.data(), m.size());
+        legacy::Packet p = legacy::portable::parseMeshPacket(e.packetData.data(), e.packetData.size());
+        return (uint64_t)p.from + p.id + p.encryptedData.size() + e.gatewayId.size();
+    });
+
+    measure("schema parser, all fields", message, iterations, [](const vector<uint8_t>& m) {
+        ServiceEnvelope e = decodeServiceEnvelope(m.data(), m.size());
+        MeshPacket p = decodeMeshPacket(e.packetData.data(), e.packetData.size());
+        return (uint64_t)p.from + p.id + p.encryptedData.size() + p.decodedData.size() + e.gatewayId.size();
+    });
+
+    measure("schema parser, pipeline fields", message, iterations, [](const vector<uint8_t>& m) {
+        ServiceEnvelope e = decodeServiceEnvelope(m.data(), m.size());
+        MeshPacket p = decodeMeshPacket<RECORD_PACKET_FIELDS>(e.packetData.data(), e.packetData.size());
+        return (uint64_t)p.from + p.id + p.encryptedData.size() + p.decodedData.size() + e.gatewayId.size();
+    });
+
+    measure("schema parser, routing fields only", message, iterations, [](const vector<uint8_t>& m) {
+        ServiceEnvelope e = decodeServiceEnvelope<fieldMask(ServiceEnvelope::PACKET, ServiceEnvelope::GATEWAY_ID)>(
+            m.data(), m.size());
+        MeshPacket p = decodeMeshPacket<fieldMask(MeshPacket::FROM, MeshPacket::TO, MeshPacket::ID,
+                                                  MeshPacket::HOP_LIMIT, MeshPacket::HOP_START)>(
+            e.packetData.data(), e.packetData.size());
+        return (uint64_t)p.from + p.id + p.hopStart + e.gatewayId.size();
+    });
+}
+
+int main(int argc, char* argv[]) {
+    size_t iterations = argc > 1 ? (size_t)strtoul(argv[1], nullptr, 10) : 2000000;
+
+    cout << "Iterations: " << iterations << endl;
+    runSuite("firmware capture (sample_messages.txt)", hexToBytes(SAMPLE_MESSAGE), iterations);
+    runSuite("legacy-shaped message", legacyShapedMessage(), iterations);
+    return 0;
+}
@@ -0,0 +1,87 @@
+// Pipeline benchmark: per-stage throughput and the latency added by each
+// SPSC handoff, under both backpressure policies.
+//
+//   pipeline_bench [messages] [queue capacity]
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+
+#include "../src/pipeline.h"
+#include "bench_common.h"
+
+using namespace std;
+
+static void runScenario(const string& title, const vector<string>& messages,
+                        PipelineConfig config, int sinkDelayUs) {
+    size_t next = 0;
+    uint64_t bytesOut = 0;
+    DecodePipeline pipeline(config);
+    PipelineReport report = pipeline.run(
+        [&](string& line) {
+            if (next >= messages.size()) return false;
+            line = messages[next++];
+            return true;
+        },
+        [&](const PacketRecord& record) {
+            bytesOut += record.summary.size();
+            if (sinkDelayUs > 0) {
+                this_thread::sleep_for(chrono::microseconds(sinkDelayUs));
+            }
+        });
+
+    cout << "\n########## " << title << " ##########" << endl;
+    printPipelineReport(cout, report);
+    cout << "Sink bytes: " << bytesOut << endl;
+}
+
+// A consumer that takes every item as soon as it is pushed keeps at most
+// one item in the queue; the reported occupancy must agree.
+static bool checkOccupancy() {
+    SpscQueue<int> queue(64);
+    int item = 0;
+    for (int i = 0; i < 100000; i++) {
+        queue.push(i, Backpressure::Block);
+        queue.pop(item);
+    }
+    QueueStats stats = queue.stats();
+    bool ok = stats.maxOccupancy <= 2;
+    cout << "Instant drain, 64 slots: max occupancy " << stats.maxOccupancy << ", avg "
+         << stats.averageOccupancy() << (ok ? "" : "  WRONG") << endl;
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? (size_t)strtoul(argv[1], nullptr, 10) : 200000;
+    size_t capacity = argc > 2 ? (size_t)strtoul(argv[2], nullptr, 10) : 1024;
+
+    vector<string> messages(count, SAMPLE_MESSAGE);
+
+    PipelineConfig config;
+    config.queueCapacity = capacity;
+    config.psk = getPSKFromInput("AQ==", false);
+
+    cout << "Messages: " << count << ", queue capacity: " << capacity
+         << ", hardware threads: " << thread::hardware_concurrency() << endl;
+    bool ok = checkOccupancy();
+
+    config.policy = Backpressure::Block;
+    runScenario("block, fast sink", messages, config, 0);
+
+    config.pinThreads = true;
+    runScenario("block, fast sink, pinned", messages, config, 0);
+    config.pinThreads = false;
+
+    // A slow sink: with Block the whole pipeline slows to its pace, with
+    // Drop ingest keeps running and the overflow is counted per queue.
+    vector<string> slowBatch(min(count, (size_t)20000), SAMPLE_MESSAGE);
+    runScenario("block, slow sink (20us)", slowBatch, config, 20);
+
+    config.policy = Backpressure::Drop;
+    runScenario("drop, slow sink (20us)", slowBatch, config, 20);
+
+    return ok ? 0 : 1;
+}
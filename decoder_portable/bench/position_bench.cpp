@@ -0,0 +1,168 @@
+// Position index benchmark: update rate, box/radius/k-nearest query latency
+// and bulk expiry on synthetic POSITION traffic. Query results are checked
+// against a linear scan over the same fixes.
+//
+//   position_bench [updates] [nodes]
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+
+#include "../src/position_index.h"
+#include "bench_common.h"
+
+using namespace std;
+
+// Radius queries whose longitude span is huge or wraps: around the north
+// pole and across the antimeridian. Checked against a linear scan.
+static bool edgeOfMapCheck() {
+    mt19937 rng(3);
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    PositionIndex index;
+    vector<PositionFix> all;
+    for (uint32_t node = 1; node <= 20000; node++) {
+        bool polar = node % 2 == 0;
+        double la = polar ? 85.0 + 5.0 * uniform(rng) : -1.0 + 2.0 * uniform(rng);
+        double lo = polar ? -180.0 + 360.0 * uniform(rng) : (node % 4 == 1 ? 179.0 : -180.0) + uniform(rng);
+        PositionFix fix{node, (int32_t)llround(la * 1e7), (int32_t)llround(lo * 1e7), 100};
+        index.update(fix.node, fix.latitudeI, fix.longitudeI, fix.time);
+        all.push_back(fix);
+    }
+
+    struct Query { double lat, lon, meters; };
+    bool ok = true;
+    for (const Query& q : {Query{89.9, 30.0, 500000.0}, Query{89.9, -170.0, 500000.0},
+                           Query{-89.9, 0.0, 500000.0}, Query{0.0, 179.95, 50000.0},
+                           Query{0.0, -179.95, 50000.0}, Query{86.0, 175.0, 200000.0}}) {
+        size_t expected = 0;
+        for (const PositionFix& f : all) {
+            expected += haversineMeters(q.lat, q.lon, f.latitude(), f.longitude()) <= q.meters;
+        }
+        size_t found = index.queryRadius(q.lat, q.lon, q.meters, 0).size();
+        cout << "radius " << (int)(q.meters / 1000) << " km at (" << q.lat << ", " << q.lon << "): "
+             << found << " nodes, linear scan " << expected << endl;
+        if (found != expected) ok = false;
+    }
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    size_t updates = argc > 1 ? (size_t)strtoul(argv[1], nullptr, 10) : 1000000;
+    uint32_t nodes = argc > 2 ? (uint32_t)strtoul(argv[2], nullptr, 10) : 50000;
+    const uint32_t span = 6 * 3600;     // six hours of traffic
+    const uint32_t now = span;
+    const uint32_t hourAgo = now - 3600;
+
+    cout << "Updates: " << updates << ", nodes: " << nodes << endl;
+
+    // Nodes random-walk around a 10 x 15 degree region.
+    mt19937 rng(7);
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    vector<double> lat(nodes), lon(nodes);
+    for (uint32_t i = 0; i < nodes; i++) {
+        lat[i] = 22.0 + 10.0 * uniform(rng);
+        lon[i] = 105.0 + 15.0 * uniform(rng);
+    }
+
+    PositionIndexConfig config;
+    config.retentionSeconds = 3 * 3600;
+    PositionIndex index(config);
+    vector<PositionFix> all;
+    all.reserve(updates);
+
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < updates; i++) {
+        uint32_t n = rng() % nodes;
+        lat[n] += (uniform(rng) - 0.5) * 0.01;
+        lon[n] += (uniform(rng) - 0.5) * 0.01;
+        uint32_t time = (uint32_t)(i * (uint64_t)span / updates);
+        PositionFix fix{n + 1, (int32_t)llround(lat[n] * 1e7), (int32_t)llround(lon[n] * 1e7), time};
+        index.update(fix.node, fix.latitudeI, fix.longitudeI, fix.time);
+        all.push_back(fix);
+    }
+    double updateUs = elapsedUs(start);
+    cout << "\nUpdate: " << fixed << setprecision(1) << updateUs / 1000 << " ms ("
+         << setprecision(0) << updates / (updateUs / 1e6) << " updates/s), "
+         << index.size() << " fixes retained in " << index.bucketCount() << " buckets" << endl;
+
+    const size_t queries = 2000;
+    vector<double> samples;
+    size_t results = 0;
+    bool correct = true;
+
+    cout << "\nQueries over the last hour (" << queries << " each):" << endl;
+    for (double size : {0.1, 0.5}) {
+        samples.clear();
+        results = 0;
+        for (size_t q = 0; q < queries; q++) {
+            double la = 22.0 + 10.0 * uniform(rng), lo = 105.0 + 15.0 * uniform(rng);
+            auto t = chrono::steady_clock::now();
+            vector<PositionFix> hits = index.queryBox(la, lo, la + size, lo + size, hourAgo);
+            samples.push_back(elapsedUs(t));
+            results += hits.size();
+
+            if (q < 20) {
+                vector<uint32_t> expected;
+                for (const PositionFix& f : all) {
+                    if (f.time >= hourAgo && f.latitude() >= la && f.latitude() <= la + size &&
+                        f.longitude() >= lo && f.longitude() <= lo + size) {
+                        expected.push_back(f.node);
+                    }
+                }
+                sort(expected.begin(), expected.end());
+                expected.erase(unique(expected.begin(), expected.end()), expected.end());
+                if (expected.size() != hits.size()) correct = false;
+            }
+        }
+        printLatency("box " + to_string(size).substr(0, 3) + " deg", samples, results);
+    }
+
+    for (double meters : {5000.0, 25000.0}) {
+        samples.clear();
+        results = 0;
+        for (size_t q = 0; q < queries; q++) {
+            double la = 22.0 + 10.0 * uniform(rng), lo = 105.0 + 15.0 * uniform(rng);
+            auto t = chrono::steady_clock::now();
+            results += index.queryRadius(la, lo, meters, hourAgo).size();
+            samples.push_back(elapsedUs(t));
+        }
+        printLatency("radius " + to_string((int)(meters / 1000)) + " km", samples, results);
+    }
+
+    for (size_t k : {1, 10, 100}) {
+        samples.clear();
+        results = 0;
+        for (size_t q = 0; q < queries; q++) {
+            double la = 22.0 + 10.0 * uniform(rng), lo = 105.0 + 15.0 * uniform(rng);
+            auto t = chrono::steady_clock::now();
+            vector<NearbyNode> near = index.nearest(la, lo, k, hourAgo);
+            samples.push_back(elapsedUs(t));
+            results += near.size();
+
+            if (q < 5) {
+                double best = 1e18;
+                for (const PositionFix& f : all) {
+                    if (f.time >= hourAgo) best = min(best, haversineMeters(la, lo, f.latitude(), f.longitude()));
+                }
+                if (near.empty() || near[0].meters > best + 1e-6) correct = false;
+            }
+        }
+        printLatency("nearest k=" + to_string(k), samples, results);
+    }
+
+    cout << "\nPoles and antimeridian:" << endl;
+    correct = edgeOfMapCheck() && correct;
+
+    cout << "\nLinear-scan cross-check: " << (correct ? "OK" : "MISMATCH") << endl;
+
+    start = chrono::steady_clock::now();
+    index.expire(now + 2 * 3600);
+    cout << "Bulk expiry of 2 hours: " << setprecision(1) << elapsedUs(start) / 1000 << " ms, "
+         << index.size() << " fixes left" << endl;
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+@echo off
+echo ==========================================
+echo   Meshtastic MQTT Decoder v2.0
+echo          BENCHMARKS
+echo ==========================================
+echo.
+
+echo Building pipeline benchmark...
+g++ -O2 -std=c++17 -static -static-libgcc -static-libstdc++ -o pipeline_bench.exe bench\pipeline_bench.cpp
+if errorlevel 1 (
+    echo Failed to build pipeline benchmark!
+    pause
+    exit /b 1
+)
+
+echo Building parser benchmark...
+g++ -O2 -std=c++17 -static -static-libgcc -static-libstdc++ -o parser_bench.exe bench\parser_bench.cpp
+if errorlevel 1 (
+    echo Failed to build parser benchmark!
+    pause
+    exit /b 1
+)
+
+echo Building topology graph benchmark...
+g++ -O2 -std=c++17 -static -static-libgcc -static-libstdc++ -o graph_bench.exe bench\graph_bench.cpp
+if errorlevel 1 (
+    echo Failed to build topology graph benchmark!
+    pause
+    exit /b 1
+)
+
+echo Building position index benchmark...
+g++ -O2 -std=c++17 -static -static-libgcc -static-libstdc++ -o position_bench.exe bench\position_bench.cpp
+if errorlevel 1 (
+    echo Failed to build position index benchmark!
+    pause
+    exit /b 1
+)
+
+echo Building checkpoint benchmark...
+g++ -O2 -std=c++17 -static -static-libgcc -static-libstdc++ -o checkpoint_bench.exe bench\checkpoint_bench.cpp
+if errorlevel 1 (
+    echo Failed to build checkpoint benchmark!
+    pause
+    exit /b 1
+)
+
+echo Building I/O benchmark...
+g++ -O2 -std=c++17 -static -static-libgcc -static-libstdc++ -o io_bench.exe bench\io_bench.cpp
+if errorlevel 1 (
+    echo Failed to build I/O benchmark!
+    pause
+    exit /b 1
+)
+
+echo Building config reload benchmark...
+g++ -O2 -std=c++17 -static -static-libgcc -static-libstdc++ -o reload_bench.exe bench\reload_bench.cpp
+if errorlevel 1 (
+    echo Failed to build config reload benchmark!
+    pause
+    exit /b 1
+)
+
+echo.
+echo ✅ Build completed successfully!
+echo.
+echo Run pipeline_bench.exe [messages] [queue capacity] to start the benchmark.
+echo Run parser_bench.exe [iterations] to compare the protobuf parsers.
+echo Run graph_bench.exe [nodes] [gateways] [reports] to measure the topology graph.
+echo Run position_bench.exe [updates] [nodes] to measure the position index.
+echo Run checkpoint_bench.exe [messages] [nodes] to measure checkpoint overhead and resume.
+echo Run io_bench.exe [messages] [block KiB] to compare file I/O backends.
+echo Run reload_bench.exe [messages] [interval ms] to check config reloads under load.
+echo.
+pause
@@ -6,7 +6,7 @@ echo ==========================================
 echo.
 
 echo Building decryption-enabled version...
-g++ -static -static-libgcc -static-libstdc++ -o mqtt_decoder_with_decryption.exe src\mqtt_decoder_with_decryption.cpp
+g++ -std=c++17 -static -static-libgcc -static-libstdc++ -o mqtt_decoder_with_decryption.exe src\mqtt_decoder_with_decryption.cpp
 if errorlevel 1 (
     echo Failed to build decryption version!
     pause
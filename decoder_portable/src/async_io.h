@@ -0,0 +1,789 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define MESH_HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+// Asynchronous block I/O for large capture and summary files.
+//
+// AsyncFileReader keeps `depth` aligned blocks of `blockSize` bytes in
+// flight ahead of the consumer and hands out lines from the block at the
+// front. AsyncFileWriter fills one block while earlier ones are being
+// written, so the caller only waits when every block is still in flight.
+//
+// Requests go to an IoEngine: io_uring on Linux (raw syscalls, kernel 5.7+),
+// otherwise a small pool of threads doing positional reads and writes.
+// With `direct`, files are opened with O_DIRECT (Linux only) so large scans
+// do not evict the page cache; if the filesystem refuses, buffered I/O is
+// used and the stats say so.
+
+enum class IoBackend {
+    Auto,       // io_uring when the kernel supports it, else threads
+    Uring,
+    Threads
+};
+
+struct AsyncIoConfig {
+    IoBackend backend = IoBackend::Auto;
+    size_t blockSize = 1 << 20;     // rounded up to IO_ALIGNMENT
+    unsigned depth = 4;             // blocks in flight per file
+    unsigned threads = 2;           // workers for the thread-pool engine
+    bool direct = false;
+};
+
+struct IoStats {
+    const char* backend = "none";
+    bool direct = false;
+    uint64_t requests = 0;
+    uint64_t bytes = 0;
+    uint64_t waitNs = 0;            // time the caller was blocked on the disk
+};
+
+static const size_t IO_ALIGNMENT = 4096;
+
+inline uint64_t ioNowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline size_t alignUp(size_t value, size_t alignment = IO_ALIGNMENT) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+inline uint64_t alignDown(uint64_t value, uint64_t alignment = IO_ALIGNMENT) {
+    return value / alignment * alignment;
+}
+
+struct AlignedFree {
+    void operator()(uint8_t* p) const {
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+};
+
+typedef std::unique_ptr<uint8_t, AlignedFree> AlignedBlock;
+
+inline AlignedBlock allocateBlock(size_t size) {
+#ifdef _WIN32
+    return AlignedBlock((uint8_t*)_aligned_malloc(size, IO_ALIGNMENT));
+#else
+    void* p = nullptr;
+    if (posix_memalign(&p, IO_ALIGNMENT, size) != 0) p = nullptr;
+    return AlignedBlock((uint8_t*)p);
+#endif
+}
+
+// ---- File helpers ----------------------------------------------------------
+
+inline std::string ioErrorText(int error) {
+    return std::strerror(error);
+}
+
+inline int openForIo(const std::string& path, bool write, bool& direct) {
+#ifdef _WIN32
+    direct = false;
+    int flags = _O_BINARY | (write ? (_O_WRONLY | _O_CREAT) : _O_RDONLY);
+    return _open(path.c_str(), flags, _S_IREAD | _S_IWRITE);
+#else
+    // read access too: an O_DIRECT writer re-reads its partial last block
+    int flags = write ? (O_RDWR | O_CREAT) : O_RDONLY;
+#ifdef O_DIRECT
+    if (direct) {
+        int fd = open(path.c_str(), flags | O_DIRECT, 0644);
+        if (fd >= 0 || errno != EINVAL) return fd;
+    }
+#endif
+    direct = false;
+    return open(path.c_str(), flags, 0644);
+#endif
+}
+
+inline void closeFile(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+inline bool fileSizeOf(int fd, uint64_t& size) {
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_fstat64(fd, &info) != 0) return false;
+#else
+    struct stat info;
+    if (fstat(fd, &info) != 0) return false;
+#endif
+    size = (uint64_t)info.st_size;
+    return true;
+}
+
+inline bool truncateFile(int fd, uint64_t size) {
+#ifdef _WIN32
+    return _chsize_s(fd, (long long)size) == 0;
+#else
+    return ftruncate(fd, (off_t)size) == 0;
+#endif
+}
+
+inline bool syncFd(int fd) {
+#ifdef _WIN32
+    return _commit(fd) == 0;
+#else
+    return fsync(fd) == 0;
+#endif
+}
+
+// Returns bytes transferred, or -errno.
+inline int64_t positionalIo(bool write, int fd, void* buffer, size_t length, uint64_t offset) {
+#ifdef _WIN32
+    HANDLE handle = (HANDLE)_get_osfhandle(fd);
+    OVERLAPPED at = {};
+    at.Offset = (DWORD)offset;
+    at.OffsetHigh = (DWORD)(offset >> 32);
+    DWORD done = 0;
+    BOOL ok = write ? WriteFile(handle, buffer, (DWORD)length, &done, &at)
+                    : ReadFile(handle, buffer, (DWORD)length, &done, &at);
+    if (!ok && GetLastError() != ERROR_HANDLE_EOF) return -EIO;
+    return done;
+#else
+    ssize_t done;
+    do {
+        done = write ? pwrite(fd, buffer, length, (off_t)offset)
+                     : pread(fd, buffer, length, (off_t)offset);
+    } while (done < 0 && errno == EINTR);
+    return done < 0 ? -errno : done;
+#endif
+}
+
+// ---- Engines ---------------------------------------------------------------
+
+struct IoRequest {
+    bool write = false;
+    int fd = -1;
+    void* buffer = nullptr;
+    size_t length = 0;
+    uint64_t offset = 0;
+    uint64_t tag = 0;
+};
+
+struct IoCompletion {
+    uint64_t tag = 0;
+    int64_t result = 0;             // bytes transferred, or -errno
+};
+
+class IoEngine {
+public:
+    virtual ~IoEngine() {}
+    virtual const char* name() const = 0;
+    virtual bool submit(const IoRequest& request) = 0;
+    // Blocks until one submitted request has completed.
+    virtual bool wait(IoCompletion& completion) = 0;
+};
+
+class ThreadPoolEngine : public IoEngine {
+public:
+    explicit ThreadPoolEngine(unsigned threads) {
+        for (unsigned i = 0; i < (threads ? threads : 1); i++) {
+            workers.emplace_back([this] { run(); });
+        }
+    }
+
+    ~ThreadPoolEngine() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    const char* name() const override { return "threads"; }
+
+    bool submit(const IoRequest& request) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(request);
+        }
+        jobReady.notify_one();
+        return true;
+    }
+
+    bool wait(IoCompletion& completion) override {
+        std::unique_lock<std::mutex> lock(mutex);
+        doneReady.wait(lock, [this] { return !done.empty(); });
+        completion = done.front();
+        done.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable doneReady;
+    std::deque<IoRequest> jobs;
+    std::deque<IoCompletion> done;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    void run() {
+        while (true) {
+            IoRequest request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) return;
+                request = jobs.front();
+                jobs.pop_front();
+            }
+            IoCompletion completion;
+            completion.tag = request.tag;
+            completion.result = positionalIo(request.write, request.fd, request.buffer,
+                                             request.length, request.offset);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.push_back(completion);
+            }
+            doneReady.notify_one();
+        }
+    }
+};
+
+#ifdef MESH_HAVE_IO_URING
+// Minimal io_uring driver: one submission per request, completions reaped
+// one at a time. The caller never has more than `entries` requests in flight.
+class UringEngine : public IoEngine {
+public:
+    ~UringEngine() override {
+        if (sqes) munmap(sqes, sqesSize);
+        if (cqRing && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing) munmap(sqRing, sqRingSize);
+        if (ringFd >= 0) close(ringFd);
+    }
+
+    bool init(unsigned entries) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+        if (ringFd < 0) return false;
+        // IORING_OP_READ/WRITE need 5.6; FAST_POLL arrived in 5.7
+        if (!(params.features & IORING_FEAT_FAST_POLL)) return false;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+        sqRing = mapRing(sqRingSize, IORING_OFF_SQ_RING);
+        if (!sqRing) return false;
+        cqRing = single ? sqRing : mapRing(cqRingSize, IORING_OFF_CQ_RING);
+        if (!cqRing) return false;
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = (io_uring_sqe*)mapRing(sqesSize, IORING_OFF_SQES);
+        if (!sqes) return false;
+
+        uint8_t* sq = (uint8_t*)sqRing;
+        sqTail = (unsigned*)(sq + params.sq_off.tail);
+        sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+        sqArray = (unsigned*)(sq + params.sq_off.array);
+        uint8_t* cq = (uint8_t*)cqRing;
+        cqHead = (unsigned*)(cq + params.cq_off.head);
+        cqTail = (unsigned*)(cq + params.cq_off.tail);
+        cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+        cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+    bool submit(const IoRequest& request) override {
+        unsigned tail = *sqTail;
+        unsigned index = tail & sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = request.write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->fd = request.fd;
+        sqe->addr = (uint64_t)(uintptr_t)request.buffer;
+        sqe->len = (uint32_t)request.length;
+        sqe->off = request.offset;
+        sqe->user_data = request.tag;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+        while (true) {
+            long submitted = syscall(__NR_io_uring_enter, ringFd, 1, 0, 0, nullptr, 0);
+            if (submitted == 1) return true;
+            if (submitted < 0 && errno != EINTR && errno != EAGAIN) return false;
+        }
+    }
+
+    bool wait(IoCompletion& completion) override {
+        while (true) {
+            unsigned head = *cqHead;
+            if (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe& cqe = cqes[head & cqMask];
+                completion.tag = cqe.user_data;
+                completion.result = cqe.res;
+                __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+            long r = syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (r < 0 && errno != EINTR) return false;
+        }
+    }
+
+private:
+    int ringFd = -1;
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+    unsigned* sqTail = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    void* mapRing(size_t size, uint64_t offset) {
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, (off_t)offset);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+};
+#endif
+
+// Only IoBackend::Auto falls back to the thread pool; an explicit Uring
+// that cannot be set up is an error.
+inline std::unique_ptr<IoEngine> makeIoEngine(const AsyncIoConfig& config, std::string& error) {
+#ifdef MESH_HAVE_IO_URING
+    if (config.backend != IoBackend::Threads) {
+        UringEngine* uring = new UringEngine();
+        if (uring->init(config.depth ? config.depth : 1)) return std::unique_ptr<IoEngine>(uring);
+        delete uring;
+        if (config.backend == IoBackend::Uring) {
+            error = "io_uring is unavailable or disabled on this system (Linux 5.7 or later is required)";
+            return nullptr;
+        }
+    }
+#else
+    if (config.backend == IoBackend::Uring) {
+        error = "io_uring is only available on Linux";
+        return nullptr;
+    }
+#endif
+    return std::unique_ptr<IoEngine>(new ThreadPoolEngine(config.threads));
+}
+
+inline bool parseIoBackend(const std::string& text, IoBackend& backend) {
+    if (text == "auto") backend = IoBackend::Auto;
+    else if (text == "uring") backend = IoBackend::Uring;
+    else if (text == "threads") backend = IoBackend::Threads;
+    else return false;
+    return true;
+}
+
+// ---- Reader ----------------------------------------------------------------
+
+class AsyncFileReader {
+public:
+    ~AsyncFileReader() { close(); }
+
+    // Opens `path` and starts reading ahead from `startOffset`.
+    bool open(const std::string& path, uint64_t startOffset, const AsyncIoConfig& config, std::string& error) {
+        close();
+        blockSize = alignUp(config.blockSize ? config.blockSize : IO_ALIGNMENT);
+        direct = config.direct;
+        fd = openForIo(path, false, direct);
+        if (fd < 0) {
+            error = "cannot open input file " + path + ": " + ioErrorText(errno);
+            return false;
+        }
+        if (!fileSizeOf(fd, fileSize)) {
+            error = "cannot stat input file " + path;
+            return false;
+        }
+        engine = makeIoEngine(config, error);
+        if (!engine) return false;
+        ioStats = IoStats();
+        ioStats.backend = engine->name();
+        ioStats.direct = direct;
+
+        slots.resize(config.depth ? config.depth : 1);
+        for (Slot& slot : slots) {
+            slot.block = allocateBlock(blockSize);
+            if (!slot.block) {
+                error = "out of memory for read buffers";
+                return false;
+            }
+        }
+        consumed = std::min(startOffset, fileSize);
+        nextOffset = alignDown(consumed);
+        position = (size_t)(consumed - nextOffset);
+        current = 0;
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (!submitNext(i)) {
+                error = failure;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Returns the next line without its '\n'; false at end of file or on
+    // error (see failed()).
+    bool nextLine(std::string& line) {
+        line.clear();
+        bool any = false;
+        while (true) {
+            Slot& slot = slots[current];
+            if (slot.state == Slot::Idle) return any;
+            if (slot.state == Slot::InFlight && !waitFor(current)) return false;
+            if (position >= slot.filled) {
+                if (!submitNext(current)) return false;
+                current = (current + 1) % slots.size();
+                position = 0;
+                continue;
+            }
+
+            const char* begin = (const char*)slot.block.get() + position;
+            size_t available = slot.filled - position;
+            const char* newline = (const char*)memchr(begin, '\n', available);
+            size_t length = newline ? (size_t)(newline - begin) : available;
+            line.append(begin, length);
+            any = true;
+            size_t used = newline ? length + 1 : length;
+            position += used;
+            consumed += used;
+            if (newline) return true;
+        }
+    }
+
+    // Input offset just past the last line returned.
+    uint64_t offset() const { return consumed; }
+    bool failed() const { return !failure.empty(); }
+    const std::string& errorText() const { return failure; }
+    const IoStats& stats() const { return ioStats; }
+
+    void close() {
+        if (engine) {
+            // buffers must outlive every read the kernel may still fill
+            for (size_t i = 0; i < slots.size(); i++) {
+                while (slots[i].state == Slot::InFlight && waitFor(i)) {}
+            }
+            engine.reset();
+        }
+        slots.clear();
+        if (fd >= 0) closeFile(fd);
+        fd = -1;
+    }
+
+private:
+    struct Slot {
+        enum State { Idle, InFlight, Ready };
+        AlignedBlock block;
+        State state = Idle;
+        uint64_t fileOffset = 0;
+        size_t expected = 0;
+        size_t filled = 0;
+    };
+
+    std::unique_ptr<IoEngine> engine;
+    std::vector<Slot> slots;
+    int fd = -1;
+    bool direct = false;
+    size_t blockSize = 0;
+    uint64_t fileSize = 0;
+    uint64_t nextOffset = 0;    // file offset of the next block to request
+    uint64_t consumed = 0;
+    size_t current = 0;         // slot holding the front block
+    size_t position = 0;        // read position within the front block
+    std::string failure;
+    IoStats ioStats;
+
+    // Queues the next unread block into slot `index`, or leaves it idle at
+    // end of file.
+    bool submitNext(size_t index) {
+        Slot& slot = slots[index];
+        slot.state = Slot::Idle;
+        slot.filled = 0;
+        if (nextOffset >= fileSize) return true;
+        slot.fileOffset = nextOffset;
+        slot.expected = (size_t)std::min<uint64_t>(blockSize, fileSize - nextOffset);
+        nextOffset += slot.expected;
+        return request(index);
+    }
+
+    bool request(size_t index) {
+        Slot& slot = slots[index];
+        IoRequest read;
+        read.fd = fd;
+        read.buffer = slot.block.get() + slot.filled;
+        read.length = slot.expected - slot.filled;
+        if (direct) read.length = alignUp(read.length);
+        read.offset = slot.fileOffset + slot.filled;
+        read.tag = index;
+        if (!engine->submit(read)) {
+            failure = "read submission failed";
+            return false;
+        }
+        slot.state = Slot::InFlight;
+        ioStats.requests++;
+        return true;
+    }
+
+    bool waitFor(size_t index) {
+        uint64_t start = ioNowNs();
+        while (slots[index].state == Slot::InFlight) {
+            IoCompletion done;
+            if (!engine->wait(done)) {
+                failure = "waiting for a read failed";
+                return false;
+            }
+            Slot& slot = slots[done.tag];
+            if (done.result < 0) {
+                slot.state = Slot::Ready;
+                failure = "read failed: " + ioErrorText((int)-done.result);
+                return false;
+            }
+            slot.filled += (size_t)done.result;
+            ioStats.bytes += (uint64_t)done.result;
+            if (done.result > 0 && slot.filled < slot.expected) {
+                if (!request(done.tag)) return false;   // short read: fetch the rest
+            } else {
+                slot.state = Slot::Ready;
+            }
+        }
+        ioStats.waitNs += ioNowNs() - start;
+        return true;
+    }
+};
+
+// ---- Writer ----------------------------------------------------------------
+
+class AsyncFileWriter {
+public:
+    ~AsyncFileWriter() { close(); }
+
+    // Opens `path` for writing at `startOffset`; anything after it is cut off.
+    bool open(const std::string& path, uint64_t startOffset, const AsyncIoConfig& config, std::string& error) {
+        close();
+        blockSize = alignUp(config.blockSize ? config.blockSize : IO_ALIGNMENT);
+        direct = config.direct;
+        fd = openForIo(path, true, direct);
+        if (fd < 0 || !truncateFile(fd, startOffset)) {
+            error = "cannot open output file " + path + ": " + ioErrorText(errno);
+            return false;
+        }
+        engine = makeIoEngine(config, error);
+        if (!engine) return false;
+        ioStats = IoStats();
+        ioStats.backend = engine->name();
+        ioStats.direct = direct;
+
+        slots.resize(config.depth ? config.depth : 1);
+        for (Slot& slot : slots) {
+            slot.block = allocateBlock(blockSize);
+            if (!slot.block) {
+                error = "out of memory for write buffers";
+                return false;
+            }
+        }
+        current = 0;
+        base = startOffset;
+        fill = 0;
+        if (direct && base % IO_ALIGNMENT) {
+            // O_DIRECT writes whole aligned blocks: start from the partial one
+            base = alignDown(startOffset);
+            fill = (size_t)(startOffset - base);
+            if (positionalIo(false, fd, slots[0].block.get(), IO_ALIGNMENT, base) != (int64_t)fill) {
+                error = "cannot read the tail of output file " + path;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool write(const char* data, size_t length) {
+        while (length > 0) {
+            size_t room = blockSize - fill;
+            size_t chunk = std::min(room, length);
+            memcpy(slots[current].block.get() + fill, data, chunk);
+            fill += chunk;
+            data += chunk;
+            length -= chunk;
+            if (fill == blockSize && !submitCurrent()) return false;
+        }
+        return true;
+    }
+
+    bool write(const std::string& text) { return write(text.data(), text.size()); }
+
+    // Writes out everything buffered and waits until it has reached the file.
+    bool flush() {
+        if (fd < 0 || failed()) return false;
+        uint64_t logical = offset();
+        Slot& slot = slots[current];
+        size_t length = direct ? alignUp(fill) : fill;
+        if (length > 0) {
+            memset(slot.block.get() + fill, 0, length - fill);
+            if (!request(current, length)) return false;
+        }
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (!waitFor(i)) return false;
+        }
+        if (direct) {
+            // drop the padding, keep the partial block for the next write
+            if (!truncateFile(fd, logical)) {
+                failure = "cannot truncate output: " + ioErrorText(errno);
+                return false;
+            }
+            size_t keep = (size_t)alignDown(fill);
+            memmove(slot.block.get(), slot.block.get() + keep, fill - keep);
+            base += keep;
+            fill -= keep;
+        } else {
+            base += fill;
+            fill = 0;
+        }
+        return true;
+    }
+
+    bool close() {
+        bool ok = true;
+        if (fd >= 0) {
+            ok = flush();
+            closeFile(fd);
+            fd = -1;
+        }
+        engine.reset();
+        slots.clear();
+        return ok;
+    }
+
+    // Bytes written so far, including those still buffered.
+    uint64_t offset() const { return base + fill; }
+    int fileDescriptor() const { return fd; }
+    bool failed() const { return !failure.empty(); }
+    const std::string& errorText() const { return failure; }
+    const IoStats& stats() const { return ioStats; }
+
+private:
+    struct Slot {
+        AlignedBlock block;
+        bool inFlight = false;
+        uint64_t fileOffset = 0;
+        size_t length = 0;
+        size_t written = 0;
+    };
+
+    std::unique_ptr<IoEngine> engine;
+    std::vector<Slot> slots;
+    int fd = -1;
+    bool direct = false;
+    size_t blockSize = 0;
+    size_t current = 0;         // slot being filled
+    uint64_t base = 0;          // file offset of the current slot
+    size_t fill = 0;
+    std::string failure;
+    IoStats ioStats;
+
+    bool submitCurrent() {
+        if (!request(current, blockSize)) return false;
+        base += blockSize;
+        fill = 0;
+        current = (current + 1) % slots.size();
+        return waitFor(current);
+    }
+
+    bool request(size_t index, size_t length) {
+        Slot& slot = slots[index];
+        slot.fileOffset = base;
+        slot.length = length;
+        slot.written = 0;
+        return resubmit(index);
+    }
+
+    bool resubmit(size_t index) {
+        Slot& slot = slots[index];
+        IoRequest write;
+        write.write = true;
+        write.fd = fd;
+        write.buffer = slot.block.get() + slot.written;
+        write.length = slot.length - slot.written;
+        write.offset = slot.fileOffset + slot.written;
+        write.tag = index;
+        if (!engine->submit(write)) {
+            failure = "write submission failed";
+            return false;
+        }
+        slot.inFlight = true;
+        ioStats.requests++;
+        return true;
+    }
+
+    bool waitFor(size_t index) {
+        if (!slots[index].inFlight) return true;
+        uint64_t start = ioNowNs();
+        while (slots[index].inFlight) {
+            IoCompletion done;
+            if (!engine->wait(done)) {
+                failure = "waiting for a write failed";
+                return false;
+            }
+            Slot& slot = slots[done.tag];
+            if (done.result <= 0) {
+                slot.inFlight = false;
+                failure = "write failed: " + ioErrorText(done.result < 0 ? (int)-done.result : EIO);
+                return false;
+            }
+            slot.written += (size_t)done.result;
+            ioStats.bytes += (uint64_t)done.result;
+            if (slot.written < slot.length) {
+                if (!resubmit(done.tag)) return false;   // short write: send the rest
+            } else {
+                slot.inFlight = false;
+            }
+        }
+        ioStats.waitNs += ioNowNs() - start;
+        return true;
+    }
+};
@@ -0,0 +1,495 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "async_io.h"
+#include "pipeline.h"
+
+// Checkpointed, resumable decoding of capture files (one hex message per
+// line) into a summary file.
+//
+// Every `checkpointEvery` records the decoder flushes its output and takes
+// a compact binary snapshot of:
+//   - the size and modification time of the input file it belongs to
+//   - the input offset (bytes consumed) and the output offset (bytes written)
+//   - the duplicate filter (the last `dedupWindow` from/id pairs)
+//   - the node table (first/last seen and packet count per sender)
+// The snapshot is handed to a background thread, which fsyncs the output
+// file and then atomically replaces the checkpoint file (write temp, fsync,
+// rename). Decoding continues meanwhile; only serialisation runs inline.
+//
+// Input and output go through AsyncFileReader/AsyncFileWriter, so reads run
+// ahead of the decoder and summaries are written in large batched blocks.
+//
+// On restart with the same checkpoint path, the output file is truncated back
+// to the recorded offset and decoding resumes at the recorded input offset
+// with the restored state, so every record is written exactly once. A
+// checkpoint taken on a different (or since modified) input is refused.
+
+struct BatchConfig {
+    std::string inputPath;
+    std::string outputPath;
+    std::string checkpointPath;         // empty: no checkpoints, no resume
+    uint64_t checkpointEvery = 100000;  // records between checkpoints
+    size_t dedupWindow = 65536;         // from/id pairs remembered
+    std::vector<uint8_t> psk;
+    AsyncIoConfig io;
+};
+
+struct BatchReport {
+    bool resumed = false;
+    uint64_t resumedAtInput = 0;
+    uint64_t records = 0;               // this run
+    uint64_t written = 0;
+    uint64_t duplicates = 0;
+    uint64_t parseFailures = 0;
+    size_t nodes = 0;
+    uint64_t checkpoints = 0;
+    uint64_t checkpointBytes = 0;       // size of the last snapshot
+    uint64_t snapshotNs = 0;            // time the decode loop spent serialising
+    uint64_t backgroundNs = 0;          // fsync + write + rename, off the decode loop
+    uint64_t wallNs = 0;
+    IoStats input;
+    IoStats output;
+};
+
+// Remembers the most recent `capacity` keys in arrival order.
+class DedupWindow {
+public:
+    explicit DedupWindow(size_t capacity = 65536) : ring(capacity ? capacity : 1) {}
+
+    // Returns false if `key` was already seen within the window.
+    bool insert(uint64_t key) {
+        if (!seen.insert(key).second) return false;
+        if (count == ring.size()) {
+            seen.erase(ring[head]);
+        } else {
+            count++;
+        }
+        ring[head] = key;
+        head = (head + 1) % ring.size();
+        return true;
+    }
+
+    template <typename Visit>
+    void forEachOldestFirst(Visit visit) const {
+        size_t first = (head + ring.size() - count) % ring.size();
+        for (size_t i = 0; i < count; i++) visit(ring[(first + i) % ring.size()]);
+    }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return ring.size(); }
+
+private:
+    std::vector<uint64_t> ring;
+    size_t head = 0;
+    size_t count = 0;
+    std::unordered_set<uint64_t> seen;
+};
+
+struct NodeEntry {
+    uint32_t firstSeen = 0;
+    uint32_t lastSeen = 0;
+    uint32_t packets = 0;
+};
+
+// Everything a resumed run needs besides the files themselves.
+struct BatchState {
+    uint64_t inputSize = 0;             // identify the input the offsets refer to
+    int64_t inputModified = 0;
+    uint64_t inputOffset = 0;
+    uint64_t outputOffset = 0;
+    uint64_t records = 0;
+    uint64_t duplicates = 0;
+    DedupWindow dedup;
+    std::unordered_map<uint32_t, NodeEntry> nodes;
+
+    explicit BatchState(size_t dedupWindow) : dedup(dedupWindow) {}
+
+    void serialize(std::vector<uint8_t>& out) const {
+        out.resize(4 + 4 + 8 * 6 + 4 + dedup.size() * 8 + 4 + nodes.size() * 16 + 8);
+        uint8_t* p = out.data();
+        memcpy(p, MAGIC, 4);
+        p = put32(p + 4, VERSION);
+        p = put64(p, inputSize);
+        p = put64(p, (uint64_t)inputModified);
+        p = put64(p, inputOffset);
+        p = put64(p, outputOffset);
+        p = put64(p, records);
+        p = put64(p, duplicates);
+        p = put32(p, (uint32_t)dedup.size());
+        dedup.forEachOldestFirst([&](uint64_t key) { p = put64(p, key); });
+        p = put32(p, (uint32_t)nodes.size());
+        for (const auto& node : nodes) {
+            p = put32(p, node.first);
+            p = put32(p, node.second.firstSeen);
+            p = put32(p, node.second.lastSeen);
+            p = put32(p, node.second.packets);
+        }
+        put64(p, checksum(out.data(), out.size() - 8));
+    }
+
+    // Replaces this state with the checkpoint in `in`. The checkpoint is
+    // parsed into a separate state first, so on failure nothing changes.
+    bool deserialize(const std::vector<uint8_t>& in) {
+        if (in.size() < 8 + 8 || memcmp(in.data(), MAGIC, 4) != 0) return false;
+        size_t body = in.size() - 8;
+        if (checksum(in.data(), body) != get64(in.data() + body)) return false;
+
+        const uint8_t* p = in.data() + 4;
+        const uint8_t* end = in.data() + body;
+        if (end - p < 4 + 8 * 6 + 4 || get32(p) != VERSION) return false;
+        p += 4;
+        BatchState parsed(dedup.capacity());
+        parsed.inputSize = get64(p); p += 8;
+        parsed.inputModified = (int64_t)get64(p); p += 8;
+        parsed.inputOffset = get64(p); p += 8;
+        parsed.outputOffset = get64(p); p += 8;
+        parsed.records = get64(p); p += 8;
+        parsed.duplicates = get64(p); p += 8;
+        if (parsed.inputOffset > parsed.inputSize || parsed.duplicates > parsed.records) return false;
+
+        uint32_t keys = get32(p); p += 4;
+        if ((size_t)(end - p) < (size_t)keys * 8 + 4) return false;
+        for (uint32_t i = 0; i < keys; i++, p += 8) {
+            if (!parsed.dedup.insert(get64(p))) return false;
+        }
+
+        uint32_t count = get32(p); p += 4;
+        if ((size_t)(end - p) != (size_t)count * 16) return false;
+        parsed.nodes.reserve(count);
+        for (uint32_t i = 0; i < count; i++, p += 16) {
+            NodeEntry& node = parsed.nodes[get32(p)];
+            node.firstSeen = get32(p + 4);
+            node.lastSeen = get32(p + 8);
+            node.packets = get32(p + 12);
+        }
+        if (parsed.nodes.size() != count) return false;
+
+        *this = std::move(parsed);
+        return true;
+    }
+
+private:
+    static constexpr uint8_t MAGIC[4] = {'M', 'Q', 'C', 'K'};
+    static const uint32_t VERSION = 2;
+
+    static uint8_t* put32(uint8_t* p, uint32_t v) {
+        for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+        return p + 4;
+    }
+    static uint8_t* put64(uint8_t* p, uint64_t v) {
+        for (int i = 0; i < 8; i++) p[i] = (uint8_t)(v >> (8 * i));
+        return p + 8;
+    }
+    static uint32_t get32(const uint8_t* p) {
+        uint32_t v = 0;
+        for (int i = 3; i >= 0; i--) v = (v << 8) | p[i];
+        return v;
+    }
+    static uint64_t get64(const uint8_t* p) {
+        uint64_t v = 0;
+        for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+        return v;
+    }
+    // FNV-1a over 64-bit words, to reject torn or foreign files
+    static uint64_t checksum(const uint8_t* data, size_t length) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        size_t i = 0;
+        for (; i + 8 <= length; i += 8) {
+            hash ^= get64(data + i);
+            hash *= 0x100000001b3ull;
+        }
+        for (; i < length; i++) {
+            hash ^= data[i];
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+};
+
+inline bool syncFile(FILE* file) {
+#ifdef _WIN32
+    return syncFd(_fileno(file));
+#else
+    return syncFd(fileno(file));
+#endif
+}
+
+// Background thread that makes snapshots durable. Only the newest pending
+// snapshot is kept: if decoding outruns the disk, older ones are skipped.
+class CheckpointWriter {
+public:
+    CheckpointWriter(const std::string& checkpointPath, int outputFd)
+        : path(checkpointPath), output(outputFd), worker([this] { run(); }) {}
+
+    ~CheckpointWriter() { finish(); }
+
+    void submit(std::vector<uint8_t>& snapshot) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.swap(snapshot);
+        hasPending = true;
+        wake.notify_one();
+    }
+
+    // Writes whatever is still pending and stops the thread.
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return;
+            stopping = true;
+            wake.notify_one();
+        }
+        worker.join();
+    }
+
+    uint64_t written() const { return writes; }
+    uint64_t busyNs() const { return busy; }
+    bool failed() const { return error; }
+
+private:
+    std::string path;
+    int output;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<uint8_t> pending;
+    bool hasPending = false;
+    bool stopping = false;
+    uint64_t writes = 0;
+    uint64_t busy = 0;
+    bool error = false;
+    std::thread worker;     // last, so it starts after the members above
+
+    void run() {
+        std::vector<uint8_t> snapshot;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return hasPending || stopping; });
+                if (!hasPending) return;
+                snapshot.swap(pending);
+                hasPending = false;
+            }
+            uint64_t t0 = pipelineNowNs();
+            if (!persist(snapshot)) error = true;
+            busy += pipelineNowNs() - t0;
+            writes++;
+        }
+    }
+
+    bool persist(const std::vector<uint8_t>& snapshot) {
+        // The output must be durable up to the recorded offset before the
+        // checkpoint that points at it.
+        if (!syncFd(output)) return false;
+
+        std::string temp = path + ".tmp";
+        FILE* file = fopen(temp.c_str(), "wb");
+        if (!file) return false;
+        bool ok = fwrite(snapshot.data(), 1, snapshot.size(), file) == snapshot.size();
+        ok = fflush(file) == 0 && ok;
+        ok = syncFile(file) && ok;
+        ok = fclose(file) == 0 && ok;
+        if (!ok) return false;
+
+        std::error_code ec;
+        std::filesystem::rename(temp, path, ec);
+        return !ec;
+    }
+};
+
+// Size and modification time of `path`, as recorded in checkpoints.
+inline bool inputIdentity(const std::string& path, uint64_t& size, int64_t& modified) {
+    std::error_code ec;
+    size = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    std::filesystem::file_time_type time = std::filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    modified = (int64_t)time.time_since_epoch().count();
+    return true;
+}
+
+// Loads the checkpoint at `path` into `state`. Returns false with `error`
+// set when it cannot be read or is not a valid checkpoint; `state` is then
+// left as it was.
+inline bool readCheckpoint(const std::string& path, BatchState& state, std::string& error) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> bytes;
+    if (in) bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if (!in || in.bad()) {
+        error = "cannot read checkpoint " + path;
+        return false;
+    }
+    if (!state.deserialize(bytes)) {
+        error = "checkpoint " + path + " is corrupt, truncated or from another version; "
+                "remove it to start over";
+        return false;
+    }
+    return true;
+}
+
+// Decodes `config.inputPath` into `config.outputPath`, resuming from the
+// checkpoint when one exists. Returns false with `error` set on I/O failure.
+inline bool runBatchDecode(const BatchConfig& config, BatchReport& report, std::string& error) {
+    uint64_t start = pipelineNowNs();
+    BatchState state(config.dedupWindow);
+    bool checkpointing = !config.checkpointPath.empty();
+
+    uint64_t inputSize = 0;
+    int64_t inputModified = 0;
+    if (!inputIdentity(config.inputPath, inputSize, inputModified)) {
+        error = "cannot stat " + config.inputPath;
+        return false;
+    }
+    // Only a missing checkpoint means a fresh start: starting over would cut
+    // the output back to nothing, so an unreadable one is an error.
+    std::error_code statError;
+    bool resume = checkpointing && std::filesystem::exists(config.checkpointPath, statError);
+    if (statError) {
+        error = "cannot stat checkpoint " + config.checkpointPath + ": " + statError.message();
+        return false;
+    }
+    if (resume) {
+        if (!readCheckpoint(config.checkpointPath, state, error)) return false;
+        if (state.inputSize != inputSize || state.inputModified != inputModified) {
+            error = "checkpoint " + config.checkpointPath + " was taken on a different or modified input; "
+                    "remove it to start over";
+            return false;
+        }
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(config.outputPath, ec);
+        if (ec || size < state.outputOffset) {
+            error = "output file is shorter than the checkpoint; cannot resume";
+            return false;
+        }
+        report.resumed = true;
+        report.resumedAtInput = state.inputOffset;
+    }
+    state.inputSize = inputSize;
+    state.inputModified = inputModified;
+
+    // The writer cuts the output back to the checkpointed offset.
+    AsyncFileWriter output;
+    AsyncFileReader input;
+    if (!output.open(config.outputPath, state.outputOffset, config.io, error) ||
+        !input.open(config.inputPath, state.inputOffset, config.io, error)) {
+        return false;
+    }
+
+    CheckpointWriter* writer = checkpointing ? new CheckpointWriter(config.checkpointPath, output.fileDescriptor()) : nullptr;
+    std::vector<uint8_t> snapshot;
+    std::string line;
+    uint64_t sinceCheckpoint = 0;
+
+    while (input.nextLine(line)) {
+        state.inputOffset = input.offset();
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+
+        PacketRecord record;
+        record.hexInput.swap(line);
+        parseRecord(record);
+        state.records++;
+        report.records++;
+
+        if (!record.envelope.valid) {
+            report.parseFailures++;
+        } else if (record.packet.valid) {
+            uint64_t key = ((uint64_t)record.packet.from << 32) | (uint32_t)record.packet.id;
+            if (record.packet.has(MeshPacket::ID) && !state.dedup.insert(key)) {
+                state.duplicates++;
+                report.duplicates++;
+                continue;
+            }
+            NodeEntry& node = state.nodes[record.packet.from];
+            uint32_t seen = record.packet.rxTime;
+            if (node.packets == 0 || seen < node.firstSeen) node.firstSeen = seen;
+            if (seen > node.lastSeen) node.lastSeen = seen;
+            node.packets++;
+        }
+
+        decryptRecord(record, config.psk);
+        summarizeRecord(record);
+        record.summary += '\n';
+        if (!output.write(record.summary)) break;
+        state.outputOffset = output.offset();
+        report.written++;
+
+        if (writer && ++sinceCheckpoint >= config.checkpointEvery) {
+            sinceCheckpoint = 0;
+            uint64_t t0 = pipelineNowNs();
+            if (!output.flush()) break;
+            state.serialize(snapshot);
+            report.checkpointBytes = snapshot.size();
+            writer->submit(snapshot);
+            report.snapshotNs += pipelineNowNs() - t0;
+        }
+    }
+
+    bool ok = output.flush();
+    if (input.failed()) {
+        ok = false;
+        error = input.errorText();
+    } else if (!ok) {
+        error = output.errorText();
+    }
+    if (writer && ok) {
+        // Final checkpoint: a rerun on the same input resumes at its end.
+        state.serialize(snapshot);
+        report.checkpointBytes = snapshot.size();
+        writer->submit(snapshot);
+    }
+    if (writer) {
+        writer->finish();
+        report.checkpoints = writer->written();
+        report.backgroundNs = writer->busyNs();
+        if (writer->failed()) {
+            ok = false;
+            if (error.empty()) error = "checkpoint write failed";
+        }
+        delete writer;
+    }
+    report.input = input.stats();
+    report.output = output.stats();
+    input.close();
+    if (!output.close() && ok) {
+        ok = false;
+        error = output.errorText();
+    }
+
+    report.nodes = state.nodes.size();
+    report.wallNs = pipelineNowNs() - start;
+    return ok;
+}
+
+inline void printBatchReport(std::ostream& out, const BatchReport& report) {
+    out << "\n=== Batch Report ===" << std::endl;
+    if (report.resumed) {
+        out << "Resumed from checkpoint at input byte " << report.resumedAtInput << std::endl;
+    }
+    out << "Records: " << report.records
+        << ", written: " << report.written
+        << ", duplicates: " << report.duplicates
+        << ", parse failures: " << report.parseFailures
+        << ", nodes: " << report.nodes << std::endl;
+    out << "Wall time: " << std::fixed << std::setprecision(1) << report.wallNs / 1e6 << " ms" << std::endl;
+    out << "Checkpoints: " << report.checkpoints
+        << " (" << report.checkpointBytes << " bytes each), inline cost "
+        << report.snapshotNs / 1e6 << " ms ("
+        << (report.wallNs ? 100.0 * report.snapshotNs / report.wallNs : 0.0) << "%), background "
+        << report.backgroundNs / 1e6 << " ms" << std::endl;
+    out << "I/O: " << report.input.backend << (report.input.direct ? " O_DIRECT" : "")
+        << ", read wait " << report.input.waitNs / 1e6 << " ms over " << report.input.requests << " requests"
+        << ", write wait " << report.output.waitNs / 1e6 << " ms over " << report.output.requests << " requests"
+        << std::endl;
+    out << std::defaultfloat << std::setprecision(6);
+}
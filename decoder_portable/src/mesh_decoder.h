@@ -0,0 +1,229 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <iomanip>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include "mesh_proto.h"
+
+// Decryption and reporting on top of the shared protobuf core. The parse
+// wrappers below print every field for the interactive mode; the pipeline
+// calls the decode* functions from mesh_proto.h directly so that no stage is
+// bound by console I/O.
+
+// Simple AES-CTR implementation for demonstration
+// Note: This is a simplified version for educational purposes
+class SimpleAES {
+private:
+    static const uint8_t sbox[256];
+    uint8_t key[16];
+
+public:
+    SimpleAES(const std::vector<uint8_t>& keyData) {
+        memset(key, 0, sizeof(key));
+        memcpy(key, keyData.data(), std::min(16, (int)keyData.size()));
+    }
+
+    void xorWithKey(uint8_t* data, size_t len) {
+        for (size_t i = 0; i < len; i++) {
+            data[i] ^= key[i % 16];
+        }
+    }
+
+    // Simplified CTR mode - just XOR with key for demonstration
+    void decryptCTR(const uint8_t* input, uint8_t* output, size_t len, uint64_t nonce) {
+        memcpy(output, input, len);
+
+        // Simple XOR with key (not real AES, but demonstrates the concept)
+        for (size_t i = 0; i < len; i++) {
+            uint8_t keyByte = key[i % 16];
+            uint8_t nonceByte = (uint8_t)((nonce >> (i % 8)) & 0xFF);
+            output[i] ^= keyByte ^ nonceByte;
+        }
+    }
+};
+
+inline const uint8_t SimpleAES::sbox[256] = {
+    // Simplified S-box for demonstration
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76
+    // ... (truncated for brevity)
+};
+
+// Verbose wrappers used by the interactive mode: decode through the shared
+// schema parser, then report every field that was present.
+inline ServiceEnvelope parseServiceEnvelope(const uint8_t* data, size_t length) {
+    using std::cout;
+    using std::endl;
+
+    ServiceEnvelope envelope = decodeServiceEnvelope(data, length);
+
+    cout << "\n=== ServiceEnvelope Parsing ===" << endl;
+    if (envelope.valid) {
+        cout << "SUCCESS: Found MeshPacket (" << envelope.packetData.size() << " bytes)" << endl;
+    }
+    if (!envelope.channelId.empty()) {
+        cout << "SUCCESS: Channel ID: " << envelope.channelId << endl;
+    }
+    if (!envelope.gatewayId.empty()) {
+        cout << "SUCCESS: Gateway ID: " << envelope.gatewayId << endl;
+    }
+    return envelope;
+}
+
+inline MeshPacket parseMeshPacket(const uint8_t* data, size_t length) {
+    using std::cout;
+    using std::endl;
+    using std::hex;
+    using std::dec;
+
+    MeshPacket packet = decodeMeshPacket(data, length);
+
+    cout << "\n=== MeshPacket Parsing ===" << endl;
+    if (packet.has(MeshPacket::FROM)) {
+        cout << "SUCCESS: From: 0x" << hex << packet.from << dec << " (!" << hex << packet.from << dec << ")" << endl;
+    }
+    if (packet.has(MeshPacket::TO)) {
+        cout << "SUCCESS: To: 0x" << hex << packet.to << dec;
+        if (packet.to == 0xFFFFFFFF) {
+            cout << " (broadcast)";
+        }
+        cout << endl;
+    }
+    if (packet.has(MeshPacket::CHANNEL)) {
+        cout << "SUCCESS: Channel: 0x" << hex << packet.channel << dec << endl;
+    }
+    if (packet.has(MeshPacket::DECODED)) {
+        cout << "SUCCESS: Plaintext data (field 4): " << packet.decodedData.size() << " bytes" << endl;
+    }
+    if (packet.has(MeshPacket::ENCRYPTED)) {
+        cout << "SUCCESS: Encrypted data (field 5): " << packet.encryptedData.size() << " bytes" << endl;
+    }
+    if (packet.has(MeshPacket::ID)) {
+        cout << "SUCCESS: ID: 0x" << hex << packet.id << dec << endl;
+    }
+    if (packet.has(MeshPacket::HOP_LIMIT)) {
+        cout << "SUCCESS: Hop Limit: " << packet.hopLimit << endl;
+    }
+    if (packet.has(MeshPacket::HOP_START)) {
+        cout << "SUCCESS: Hop Start: " << packet.hopStart << endl;
+    }
+    if (packet.has(MeshPacket::WANT_ACK)) {
+        cout << "SUCCESS: Want ACK: " << (packet.wantAck ? "true" : "false") << endl;
+    }
+    if (!packet.valid) {
+        cout << "WARNING: MeshPacket is truncated or malformed" << endl;
+    }
+    cout << "DEBUG: Final encrypted data size: " << packet.encryptedData.size() << " bytes" << endl;
+
+    return packet;
+}
+
+inline bool textMessage(const DataMessage& data, std::string& text) {
+    if (!data.valid || data.portnum != PORT_TEXT_MESSAGE) return false;
+    text.assign(data.payload.begin(), data.payload.end());
+    return true;
+}
+
+// Extracts the text of an unencrypted TEXT_MESSAGE packet (field 4).
+inline bool plaintextMessage(const MeshPacket& packet, std::string& text) {
+    if (!packet.has(MeshPacket::DECODED)) return false;
+    DataMessage data = decodeDataMessage(packet.decodedData.data(), packet.decodedData.size());
+    return textMessage(data, text);
+}
+
+// Decrypts `encryptedData` into `decrypted` and interprets it as text.
+// Returns true when the plaintext is readable; `text` receives it.
+inline bool decryptPayload(const std::vector<uint8_t>& encryptedData, const std::vector<uint8_t>& psk,
+                           uint64_t messageId, uint32_t fromNode,
+                           std::vector<uint8_t>& decrypted, std::string& text) {
+    text.clear();
+    decrypted.clear();
+    if (encryptedData.empty() || psk.size() < 16) {
+        return false;
+    }
+
+    SimpleAES aes(psk);
+    uint64_t nonce = messageId ^ ((uint64_t)fromNode << 32);
+    decrypted.resize(encryptedData.size());
+    aes.decryptCTR(encryptedData.data(), decrypted.data(), encryptedData.size(), nonce);
+
+    for (uint8_t byte : decrypted) {
+        if (byte >= 32 && byte <= 126) {  // Printable ASCII
+            text += (char)byte;
+        } else if (byte == 0) {
+            break;  // Null terminator
+        } else {
+            text.clear();
+            return false;
+        }
+    }
+    return !text.empty();
+}
+
+inline bool attemptDecryption(const std::vector<uint8_t>& encryptedData, const std::vector<uint8_t>& psk, uint64_t messageId, uint32_t fromNode, const std::string& expectedContent = "") {
+    using std::cout;
+    using std::endl;
+    using std::hex;
+    using std::dec;
+
+    cout << "\n=== ATTEMPTING DECRYPTION ===" << endl;
+    printHex(encryptedData, "Encrypted data");
+    printHex(psk, "PSK");
+
+    if (encryptedData.empty() || psk.size() < 16) {
+        cout << "ERROR: Invalid data or PSK for decryption!" << endl;
+        return false;
+    }
+
+    // Create nonce from message ID and sender
+    uint64_t nonce = messageId ^ ((uint64_t)fromNode << 32);
+    cout << "Nonce: 0x" << hex << nonce << dec << endl;
+
+    std::vector<uint8_t> decrypted;
+    std::string decryptedText;
+    bool validText = decryptPayload(encryptedData, psk, messageId, fromNode, decrypted, decryptedText);
+
+    printHex(decrypted, "Decrypted raw");
+
+    cout << "\n=== DECRYPTION RESULTS ===" << endl;
+    if (validText) {
+        cout << "SUCCESS: Decrypted text: \"" << decryptedText << "\"" << endl;
+
+        if (!expectedContent.empty()) {
+            if (decryptedText == expectedContent) {
+                cout << "SUCCESS: Matches expected content!" << endl;
+                return true;
+            } else {
+                cout << "WARNING: Does not match expected content (" << expectedContent << ")" << endl;
+            }
+        }
+        return true;
+    } else {
+        cout << "INFO: Could not interpret as readable text" << endl;
+        cout << "Raw decrypted bytes: ";
+        for (size_t i = 0; i < std::min((size_t)20, decrypted.size()); i++) {
+            cout << "0x" << hex << std::setw(2) << std::setfill('0') << (int)decrypted[i] << " ";
+        }
+        cout << dec << endl;
+        return false;
+    }
+}
+
+inline std::vector<uint8_t> getPSKFromInput(const std::string& pskInput, bool verbose = true) {
+    const uint8_t defaultpsk[] = {
+        0xd4, 0xf1, 0xbb, 0x3a, 0x20, 0x29, 0x07, 0x59,
+        0xf0, 0xbc, 0xff, 0xab, 0xcf, 0x4e, 0x69, 0x01
+    };
+
+    if (pskInput == "AQ==") {
+        if (verbose) std::cout << "Using PSK #1 (default shared key)" << std::endl;
+        return std::vector<uint8_t>(defaultpsk, defaultpsk + 16);
+    } else {
+        if (verbose) std::cout << "Using custom PSK: " << pskInput << std::endl;
+        return hexToBytes(pskInput);
+    }
+}
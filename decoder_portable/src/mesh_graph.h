@@ -0,0 +1,563 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh_proto.h"
+
+// Live mesh topology built from decoded traffic.
+//
+// Two kinds of relation are tracked:
+//   reach - gateway G reported a packet from node N that had travelled
+//           `hops` relays (hopStart - hopLimit)
+//   link  - an inferred radio link between two nodes: a zero-hop reach,
+//           consecutive nodes of a TRACEROUTE route, or a NEIGHBORINFO entry
+//
+// Observations are appended to a log under a short lock. Queries run on an
+// immutable CSR snapshot that a background thread rebuilds every
+// maxSnapshotAgeMs while events arrive: pending events are sorted, merged
+// into the compacted edge list (aggregating duplicates and dropping edges
+// older than maxEdgeAge) and laid out as offset/entry arrays. Event times
+// come from gateways, so they are clamped to the local clock plus
+// maxClockSkew before they can move the age cutoff. Queries read the last
+// published snapshot through a shared_ptr, so they never wait for a rebuild
+// or block ingest, and a rebuild never invalidates a snapshot that is still
+// being read.
+
+static const uint8_t HOPS_UNKNOWN = 0xFF;
+static const uint32_t NODE_BROADCAST = 0xFFFFFFFF;
+
+enum LinkSource : uint8_t {
+    LINK_DIRECT = 1,        // zero-hop reception by a gateway
+    LINK_TRACEROUTE = 2,
+    LINK_NEIGHBORINFO = 4
+};
+
+struct MeshGraphConfig {
+    uint32_t maxEdgeAge = 24 * 3600;    // seconds, relative to the newest event
+    uint32_t maxClockSkew = 600;        // seconds an event may be ahead of the local clock
+    uint32_t maxSnapshotAgeMs = 100;    // interval between background rebuilds while events arrive
+};
+
+struct GatewayReach {
+    uint32_t gateway;
+    uint8_t hops;       // HOPS_UNKNOWN when the packet carried no hop_start
+    uint32_t lastSeen;
+    uint32_t count;
+};
+
+struct NodeDistance {
+    uint32_t node;
+    uint32_t links;     // number of radio links from the gateway
+};
+
+struct MeshLink {
+    uint32_t node;
+    uint8_t sources;    // LinkSource bits
+    uint32_t lastSeen;
+};
+
+// "!849c57c0" -> 0x849c57c0
+inline bool parseNodeId(const std::string& text, uint32_t& node) {
+    if (text.size() < 2 || text[0] != '!') return false;
+    char* end = nullptr;
+    unsigned long value = strtoul(text.c_str() + 1, &end, 16);
+    if (end == text.c_str() + 1 || *end != '\0') return false;
+    node = (uint32_t)value;
+    return true;
+}
+
+class TopologySnapshot {
+public:
+    size_t nodeCount() const { return ids.size(); }
+    size_t reachCount() const { return reach.size(); }
+    size_t linkCount() const { return links.size() / 2; }
+    size_t gatewayCount() const {
+        size_t gateways = 0;
+        for (size_t i = 0; i + 1 < heardOffset.size(); i++) {
+            if (heardOffset[i + 1] > heardOffset[i]) gateways++;
+        }
+        return gateways;
+    }
+
+    // Gateways that hear `node`, fewest hops first, then most recent.
+    std::vector<GatewayReach> bestGateways(uint32_t node, size_t limit = 8) const {
+        std::vector<GatewayReach> result;
+        uint32_t index;
+        if (!lookup(node, index)) return result;
+        for (uint32_t e = reachOffset[index]; e < reachOffset[index + 1] && result.size() < limit; e++) {
+            const ReachEntry& r = reach[e];
+            result.push_back(GatewayReach{ids[r.other], r.hops, r.lastSeen, r.count});
+        }
+        return result;
+    }
+
+    // Nodes within `maxLinks` radio links of `gateway`. A node the gateway
+    // heard after h relays is h + 1 links away; inferred links add one each.
+    std::vector<NodeDistance> nodesWithinHops(uint32_t gateway, uint32_t maxLinks) const {
+        std::vector<NodeDistance> result;
+        uint32_t start;
+        if (!lookup(gateway, start) || maxLinks == 0) return result;
+
+        Scratch& scratch = scratchFor(ids.size());
+        uint32_t epoch = scratch.epoch;
+        std::vector<std::vector<uint32_t>>& buckets = scratch.buckets;
+        if (buckets.size() < maxLinks + 1) buckets.resize(maxLinks + 1);
+        for (uint32_t d = 0; d <= maxLinks; d++) buckets[d].clear();
+
+        auto relax = [&](uint32_t node, uint32_t distance) {
+            if (distance > maxLinks) return;
+            if (scratch.seen[node] == epoch && scratch.distance[node] <= distance) return;
+            scratch.seen[node] = epoch;
+            scratch.distance[node] = distance;
+            buckets[distance].push_back(node);
+        };
+
+        relax(start, 0);
+        for (uint32_t e = heardOffset[start]; e < heardOffset[start + 1]; e++) {
+            const ReachEntry& r = heard[e];
+            if (r.hops != HOPS_UNKNOWN) relax(r.other, (uint32_t)r.hops + 1);
+        }
+
+        for (uint32_t d = 0; d <= maxLinks; d++) {
+            for (size_t i = 0; i < buckets[d].size(); i++) {
+                uint32_t node = buckets[d][i];
+                if (scratch.distance[node] != d) continue;  // superseded by a shorter path
+                if (node != start) result.push_back(NodeDistance{ids[node], d});
+                if (d == maxLinks) continue;    // its links lead past the limit
+                for (uint32_t e = linkOffset[node]; e < linkOffset[node + 1]; e++) {
+                    relax(links[e].other, d + 1);
+                }
+            }
+        }
+        return result;
+    }
+
+    std::vector<MeshLink> neighbors(uint32_t node) const {
+        std::vector<MeshLink> result;
+        uint32_t index;
+        if (!lookup(node, index)) return result;
+        for (uint32_t e = linkOffset[index]; e < linkOffset[index + 1]; e++) {
+            result.push_back(MeshLink{ids[links[e].other], links[e].sources, links[e].lastSeen});
+        }
+        return result;
+    }
+
+private:
+    friend class MeshGraph;
+
+    struct ReachEntry {
+        uint32_t other;
+        uint32_t lastSeen;
+        uint32_t count;
+        uint8_t hops;
+    };
+
+    struct LinkEntry {
+        uint32_t other;
+        uint32_t lastSeen;
+        uint8_t sources;
+    };
+
+    struct Scratch {
+        std::vector<uint32_t> seen;
+        std::vector<uint32_t> distance;
+        std::vector<std::vector<uint32_t>> buckets;
+        uint32_t epoch = 0;
+    };
+
+    std::vector<uint32_t> ids;          // dense index -> node number
+    std::vector<uint32_t> sortedIds;    // node numbers, ascending
+    std::vector<uint32_t> sortedIndex;  // dense index for each sortedIds entry
+
+    std::vector<uint32_t> reachOffset;  // node -> gateways that hear it
+    std::vector<ReachEntry> reach;
+    std::vector<uint32_t> heardOffset;  // gateway -> nodes it hears
+    std::vector<ReachEntry> heard;
+    std::vector<uint32_t> linkOffset;   // node -> linked nodes (both directions)
+    std::vector<LinkEntry> links;
+
+    uint64_t builtAtMs = 0;
+
+    bool lookup(uint32_t node, uint32_t& index) const {
+        auto it = std::lower_bound(sortedIds.begin(), sortedIds.end(), node);
+        if (it == sortedIds.end() || *it != node) return false;
+        index = sortedIndex[it - sortedIds.begin()];
+        return true;
+    }
+
+    // Per-thread BFS state, reused across queries and snapshots; bumping the
+    // epoch invalidates every `seen` mark without clearing the array.
+    static Scratch& scratchFor(size_t nodes) {
+        static thread_local Scratch scratch;
+        if (scratch.seen.size() < nodes) {
+            scratch.seen.resize(nodes, 0);
+            scratch.distance.resize(nodes, 0);
+        }
+        if (++scratch.epoch == 0) {
+            std::fill(scratch.seen.begin(), scratch.seen.end(), 0);
+            scratch.epoch = 1;
+        }
+        return scratch;
+    }
+};
+
+class MeshGraph {
+public:
+    explicit MeshGraph(const MeshGraphConfig& cfg = MeshGraphConfig()) : config(cfg) {
+        std::vector<uint32_t> none;
+        published = buildSnapshot(none, nowMs());
+    }
+
+    ~MeshGraph() {
+        {
+            std::lock_guard<std::mutex> lock(builderMutex);
+            stopping = true;
+        }
+        builderWake.notify_all();
+        if (builder.joinable()) builder.join();
+    }
+
+    MeshGraph(const MeshGraph&) = delete;
+    MeshGraph& operator=(const MeshGraph&) = delete;
+
+    // Records what one decoded packet tells us about the topology.
+    void observe(const ServiceEnvelope& envelope, const MeshPacket& packet, uint32_t time) {
+        observeReport(envelope, packet, time);
+        if (packet.has(MeshPacket::DECODED)) {
+            DataMessage data = decodeDataMessage(packet.decodedData.data(), packet.decodedData.size());
+            if (data.valid) observeData(packet, data, time);
+        }
+    }
+
+    // The gateway report alone: who heard `packet.from`, after how many hops.
+    void observeReport(const ServiceEnvelope& envelope, const MeshPacket& packet, uint32_t time) {
+        uint32_t gateway;
+        if (packet.has(MeshPacket::FROM) && parseNodeId(envelope.gatewayId, gateway) && gateway != packet.from) {
+            uint8_t hops = HOPS_UNKNOWN;
+            if (packet.has(MeshPacket::HOP_START) && packet.hopStart >= packet.hopLimit) {
+                hops = (uint8_t)std::min<uint32_t>(packet.hopStart - packet.hopLimit, HOPS_UNKNOWN - 1);
+            }
+            addReach(packet.from, gateway, hops, time);
+            if (hops == 0) addLink(packet.from, gateway, LINK_DIRECT, time);
+        }
+    }
+
+    // TRACEROUTE and NEIGHBORINFO payloads, plaintext or decrypted.
+    void observeData(const MeshPacket& packet, const DataMessage& data, uint32_t time) {
+        if (data.portnum == PORT_TRACEROUTE) {
+            RouteDiscovery route = decodeMessage<RouteDiscoveryLayout, RouteDiscovery>(
+                data.payload.data(), data.payload.size());
+            if (!route.valid) return;
+            // A reply travels back from the destination (packet.from) to the
+            // origin (packet.to); `route` lists the hops origin -> destination
+            // and `routeBack` the hops destination -> origin.
+            bool reply = data.requestId != 0;
+            std::vector<uint32_t> towards;
+            towards.push_back(reply ? packet.to : packet.from);
+            towards.insert(towards.end(), route.route.begin(), route.route.end());
+            if (reply) towards.push_back(packet.from);
+            addChain(towards, time);
+
+            if (reply && !route.routeBack.empty()) {
+                std::vector<uint32_t> back;
+                back.push_back(packet.from);
+                back.insert(back.end(), route.routeBack.begin(), route.routeBack.end());
+                back.push_back(packet.to);
+                addChain(back, time);
+            }
+        } else if (data.portnum == PORT_NEIGHBORINFO) {
+            NeighborInfo info = decodeMessage<NeighborInfoLayout, NeighborInfo>(
+                data.payload.data(), data.payload.size());
+            if (!info.valid) return;
+            uint32_t self = info.nodeId ? info.nodeId : packet.from;
+            for (const std::vector<uint8_t>& encoded : info.neighbors) {
+                Neighbor neighbor = decodeMessage<NeighborLayout, Neighbor>(encoded.data(), encoded.size());
+                if (neighbor.valid && neighbor.nodeId != 0) {
+                    addLink(self, neighbor.nodeId, LINK_NEIGHBORINFO, time);
+                }
+            }
+        }
+    }
+
+    void addReach(uint32_t node, uint32_t gateway, uint8_t hops, uint32_t time) {
+        if (!isNode(node) || !isNode(gateway)) return;
+        time = clampTime(time);
+        std::lock_guard<std::mutex> lock(ingestMutex);
+        pending.push_back(Event{KIND_REACH, indexOf(node), indexOf(gateway), time, 1, hops, 0});
+        if (time > newestTime) newestTime = time;
+        startBuilder();
+    }
+
+    void addLink(uint32_t a, uint32_t b, LinkSource source, uint32_t time) {
+        if (a == b || !isNode(a) || !isNode(b)) return;
+        time = clampTime(time);
+        std::lock_guard<std::mutex> lock(ingestMutex);
+        uint32_t ia = indexOf(a);
+        uint32_t ib = indexOf(b);
+        if (ia > ib) std::swap(ia, ib);
+        pending.push_back(Event{KIND_LINK, ia, ib, time, 1, HOPS_UNKNOWN, (uint8_t)source});
+        if (time > newestTime) newestTime = time;
+        startBuilder();
+    }
+
+    // The last published snapshot, at most about maxSnapshotAgeMs behind
+    // ingest. With `fresh`, pending events are folded in first on the
+    // calling thread, for a final summary or a test.
+    std::shared_ptr<const TopologySnapshot> snapshot(bool fresh = false) {
+        if (fresh) {
+            std::lock_guard<std::mutex> build(buildMutex);
+            rebuild();
+        }
+        return std::atomic_load(&published);
+    }
+
+    std::vector<GatewayReach> bestGateways(uint32_t node, size_t limit = 8) {
+        return snapshot()->bestGateways(node, limit);
+    }
+
+    std::vector<NodeDistance> nodesWithinHops(uint32_t gateway, uint32_t maxLinks) {
+        return snapshot()->nodesWithinHops(gateway, maxLinks);
+    }
+
+private:
+    enum : uint8_t { KIND_REACH = 0, KIND_LINK = 1 };
+
+    struct Event {
+        uint8_t kind;
+        uint32_t a;         // reach: node, link: lower index
+        uint32_t b;         // reach: gateway, link: higher index
+        uint32_t lastSeen;
+        uint32_t count;
+        uint8_t hops;
+        uint8_t sources;
+
+        bool sameEdge(const Event& other) const {
+            return kind == other.kind && a == other.a && b == other.b;
+        }
+    };
+
+    static bool edgeOrder(const Event& x, const Event& y) {
+        if (x.kind != y.kind) return x.kind < y.kind;
+        if (x.a != y.a) return x.a < y.a;
+        return x.b < y.b;
+    }
+
+    MeshGraphConfig config;
+
+    std::mutex ingestMutex;                      // guards the four below
+    std::vector<Event> pending;
+    std::unordered_map<uint32_t, uint32_t> indexByNode;
+    std::vector<uint32_t> nodeIds;
+    uint32_t newestTime = 0;
+
+    std::mutex buildMutex;                       // guards compacted and rebuilds
+    std::vector<Event> compacted;                // sorted, one entry per edge
+    std::shared_ptr<const TopologySnapshot> published;  // atomic_load/atomic_store only
+
+    std::once_flag builderStarted;
+    std::thread builder;
+    std::mutex builderMutex;                     // guards stopping
+    std::condition_variable builderWake;
+    bool stopping = false;
+
+    static uint64_t nowMs() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static bool isNode(uint32_t node) {
+        return node != 0 && node != NODE_BROADCAST;
+    }
+
+    uint32_t clampTime(uint32_t time) const {
+        uint64_t limit = (uint64_t)std::time(nullptr) + config.maxClockSkew;
+        return time > limit ? (uint32_t)limit : time;
+    }
+
+    // Started by the first event, so a graph that is never fed costs no
+    // thread. Called with ingestMutex held; the builder only takes it later.
+    void startBuilder() {
+        std::call_once(builderStarted, [this] { builder = std::thread([this] { runBuilder(); }); });
+    }
+
+    void runBuilder() {
+        std::unique_lock<std::mutex> lock(builderMutex);
+        while (!stopping) {
+            builderWake.wait_for(lock, std::chrono::milliseconds(config.maxSnapshotAgeMs));
+            if (stopping) break;
+            lock.unlock();
+            {
+                std::lock_guard<std::mutex> build(buildMutex);
+                rebuild();
+            }
+            lock.lock();
+        }
+    }
+
+    // Folds pending events into a new snapshot and publishes it. Called
+    // with buildMutex held.
+    void rebuild() {
+        std::vector<Event> batch;
+        uint32_t newest;
+        {
+            std::lock_guard<std::mutex> lock(ingestMutex);
+            if (pending.empty()) return;
+            batch.swap(pending);
+            newest = newestTime;
+        }
+        compact(batch, newest);
+        std::vector<uint32_t> ids = pruneNodes();
+        std::atomic_store(&published, buildSnapshot(ids, nowMs()));
+    }
+
+    void addChain(const std::vector<uint32_t>& chain, uint32_t time) {
+        for (size_t i = 0; i + 1 < chain.size(); i++) {
+            addLink(chain[i], chain[i + 1], LINK_TRACEROUTE, time);
+        }
+    }
+
+    uint32_t indexOf(uint32_t node) {
+        auto it = indexByNode.find(node);
+        if (it != indexByNode.end()) return it->second;
+        uint32_t index = (uint32_t)nodeIds.size();
+        indexByNode.emplace(node, index);
+        nodeIds.push_back(node);
+        return index;
+    }
+
+    // Folds `batch` into the compacted edge list and drops aged-out edges.
+    void compact(std::vector<Event>& batch, uint32_t newest) {
+        std::sort(batch.begin(), batch.end(), edgeOrder);
+        std::vector<Event> merged;
+        merged.reserve(compacted.size() + batch.size());
+        std::merge(compacted.begin(), compacted.end(), batch.begin(), batch.end(),
+                   std::back_inserter(merged), edgeOrder);
+
+        uint32_t cutoff = newest > config.maxEdgeAge ? newest - config.maxEdgeAge : 0;
+        compacted.clear();
+        for (const Event& e : merged) {
+            if (!compacted.empty() && compacted.back().sameEdge(e)) {
+                Event& edge = compacted.back();
+                edge.lastSeen = std::max(edge.lastSeen, e.lastSeen);
+                edge.count += e.count;
+                edge.hops = std::min(edge.hops, e.hops);
+                edge.sources |= e.sources;
+            } else {
+                compacted.push_back(e);
+            }
+        }
+        compacted.erase(std::remove_if(compacted.begin(), compacted.end(),
+                                       [&](const Event& e) { return e.lastSeen < cutoff; }),
+                        compacted.end());
+    }
+
+    // Once a quarter of the node index is no longer referenced by any
+    // compacted or pending edge, drops those nodes and renumbers the rest so
+    // the index does not grow with every node ever seen. Returns the node
+    // ids for the next snapshot. Called with buildMutex held.
+    std::vector<uint32_t> pruneNodes() {
+        static const uint32_t UNUSED = 0xFFFFFFFF;
+        std::lock_guard<std::mutex> lock(ingestMutex);
+        size_t n = nodeIds.size();
+        std::vector<uint32_t> remap(n, UNUSED);
+        auto mark = [&](const Event& e) { remap[e.a] = remap[e.b] = 0; };
+        std::for_each(compacted.begin(), compacted.end(), mark);
+        std::for_each(pending.begin(), pending.end(), mark);
+
+        uint32_t live = 0;
+        for (uint32_t& index : remap) {
+            if (index != UNUSED) index = live++;
+        }
+        if ((n - live) * 4 < n) return nodeIds;
+
+        std::vector<uint32_t> ids(live);
+        indexByNode.clear();
+        for (size_t i = 0; i < n; i++) {
+            if (remap[i] == UNUSED) continue;
+            ids[remap[i]] = nodeIds[i];
+            indexByNode.emplace(nodeIds[i], remap[i]);
+        }
+        nodeIds.swap(ids);
+        // The remap keeps relative order, so link ends stay ordered and
+        // `compacted` stays sorted.
+        auto renumber = [&](Event& e) {
+            e.a = remap[e.a];
+            e.b = remap[e.b];
+        };
+        std::for_each(compacted.begin(), compacted.end(), renumber);
+        std::for_each(pending.begin(), pending.end(), renumber);
+        return nodeIds;
+    }
+
+    std::shared_ptr<const TopologySnapshot> buildSnapshot(std::vector<uint32_t>& ids, uint64_t now) const {
+        typedef TopologySnapshot::ReachEntry ReachEntry;
+        typedef TopologySnapshot::LinkEntry LinkEntry;
+
+        std::shared_ptr<TopologySnapshot> snap = std::make_shared<TopologySnapshot>();
+        size_t n = ids.size();
+        snap->builtAtMs = now;
+        snap->ids.swap(ids);
+
+        snap->sortedIndex.resize(n);
+        for (size_t i = 0; i < n; i++) snap->sortedIndex[i] = (uint32_t)i;
+        std::sort(snap->sortedIndex.begin(), snap->sortedIndex.end(),
+                  [&](uint32_t x, uint32_t y) { return snap->ids[x] < snap->ids[y]; });
+        snap->sortedIds.resize(n);
+        for (size_t i = 0; i < n; i++) snap->sortedIds[i] = snap->ids[snap->sortedIndex[i]];
+
+        snap->reachOffset.assign(n + 1, 0);
+        snap->heardOffset.assign(n + 1, 0);
+        snap->linkOffset.assign(n + 1, 0);
+        for (const Event& e : compacted) {
+            if (e.kind == KIND_REACH) {
+                snap->reachOffset[e.a + 1]++;
+                snap->heardOffset[e.b + 1]++;
+            } else {
+                snap->linkOffset[e.a + 1]++;
+                snap->linkOffset[e.b + 1]++;
+            }
+        }
+        for (size_t i = 0; i < n; i++) {
+            snap->reachOffset[i + 1] += snap->reachOffset[i];
+            snap->heardOffset[i + 1] += snap->heardOffset[i];
+            snap->linkOffset[i + 1] += snap->linkOffset[i];
+        }
+
+        snap->reach.resize(snap->reachOffset[n]);
+        snap->heard.resize(snap->heardOffset[n]);
+        snap->links.resize(snap->linkOffset[n]);
+        std::vector<uint32_t> reachFill(snap->reachOffset.begin(), snap->reachOffset.end() - 1);
+        std::vector<uint32_t> heardFill(snap->heardOffset.begin(), snap->heardOffset.end() - 1);
+        std::vector<uint32_t> linkFill(snap->linkOffset.begin(), snap->linkOffset.end() - 1);
+        for (const Event& e : compacted) {
+            if (e.kind == KIND_REACH) {
+                snap->reach[reachFill[e.a]++] = ReachEntry{e.b, e.lastSeen, e.count, e.hops};
+                snap->heard[heardFill[e.b]++] = ReachEntry{e.a, e.lastSeen, e.count, e.hops};
+            } else {
+                snap->links[linkFill[e.a]++] = LinkEntry{e.b, e.lastSeen, e.sources};
+                snap->links[linkFill[e.b]++] = LinkEntry{e.a, e.lastSeen, e.sources};
+            }
+        }
+
+        // Pre-rank each node's gateways so bestGateways() is a prefix read.
+        for (size_t i = 0; i < n; i++) {
+            std::sort(snap->reach.begin() + snap->reachOffset[i], snap->reach.begin() + snap->reachOffset[i + 1],
+                      [](const ReachEntry& x, const ReachEntry& y) {
+                          if (x.hops != y.hops) return x.hops < y.hops;
+                          return x.lastSeen > y.lastSeen;
+                      });
+        }
+        return snap;
+    }
+};
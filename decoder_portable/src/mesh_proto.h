@@ -0,0 +1,466 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <iomanip>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+
+// Schema-driven protobuf decoding shared by both decoders.
+//
+// Each message layout is declared exactly once as a MessageLayout of Field
+// entries (field number, wire type, destination member). The per-field
+// handlers are instantiated from those declarations and the parse loop finds
+// them through a compile-time table indexed by tag, one load and an indirect
+// call per field. Callers may pass a compile-time mask of wanted field
+// numbers; anything not in the mask is skipped by length without being
+// decoded or copied.
+//
+// Layouts follow meshtastic/mqtt.proto and meshtastic/mesh.proto. A few
+// alternative wire types (varint from/to, varint/fixed64 id) are accepted
+// as well so that captures produced by older tools still decode.
+
+// 将十六进制字符串转换为字节数组
+inline std::vector<uint8_t> hexToBytes(std::string hex) {
+    std::vector<uint8_t> result;
+    // 移除所有空格、换行等空白字符
+    hex.erase(std::remove_if(hex.begin(), hex.end(), [](char c) { return isspace((unsigned char)c); }), hex.end());
+
+    for (size_t i = 0; i < hex.length(); i += 2) {
+        if (i + 1 < hex.length()) {
+            std::string byteString = hex.substr(i, 2);
+            uint8_t byte = (uint8_t)strtol(byteString.c_str(), nullptr, 16);
+            result.push_back(byte);
+        }
+    }
+    return result;
+}
+
+// 打印字节数组
+inline void printHex(const std::vector<uint8_t>& data, const std::string& label = "") {
+    if (!label.empty()) {
+        std::cout << label << ": ";
+    }
+    for (size_t i = 0; i < data.size(); i++) {
+        std::cout << std::hex << std::setw(2) << std::setfill('0') << (int)data[i];
+        if (i < data.size() - 1) std::cout << " ";
+    }
+    std::cout << std::dec << std::endl;
+}
+
+// 解析varint
+inline uint64_t decodeVarint(const uint8_t*& data, size_t& remaining) {
+    // Tags, lengths and small values are a single byte.
+    if (remaining > 0 && *data < 0x80) {
+        remaining--;
+        return *data++;
+    }
+    uint64_t result = 0;
+    int shift = 0;
+
+    while (remaining > 0 && shift < 64) {
+        uint8_t byte = *data++;
+        remaining--;
+        result |= ((uint64_t)(byte & 0x7F)) << shift;
+        if ((byte & 0x80) == 0) break;
+        shift += 7;
+    }
+    return result;
+}
+
+enum WireType : uint32_t {
+    WIRE_VARINT = 0,
+    WIRE_FIXED64 = 1,
+    WIRE_LENGTH_DELIMITED = 2,
+    WIRE_FIXED32 = 5
+};
+
+constexpr uint32_t makeTag(uint32_t number, WireType wire) {
+    return (number << 3) | (uint32_t)wire;
+}
+
+// Bit mask over field numbers, used to select the fields a caller wants.
+template <typename... Numbers>
+constexpr uint64_t fieldMask(Numbers... numbers) {
+    return ((1ull << (uint32_t)numbers) | ... | 0ull);
+}
+
+// 跳过未知字段. Returns false if the field runs past the end of the buffer
+// or uses an unsupported wire type (groups).
+inline bool skipField(uint32_t wireType, const uint8_t*& ptr, size_t& remaining) {
+    size_t length;
+    switch (wireType) {
+        case WIRE_VARINT:
+            decodeVarint(ptr, remaining);
+            return true;
+        case WIRE_FIXED64:
+            length = 8;
+            break;
+        case WIRE_LENGTH_DELIMITED:
+            length = (size_t)decodeVarint(ptr, remaining);
+            break;
+        case WIRE_FIXED32:
+            length = 4;
+            break;
+        default:
+            return false;
+    }
+    if (remaining < length) return false;
+    ptr += length;
+    remaining -= length;
+    return true;
+}
+
+// One field of a message layout: `Member` receives the value of field
+// `Number` when it arrives with wire type `Wire`. Declaring the same number
+// twice with different wire types accepts both encodings.
+template <uint32_t Number, WireType Wire, auto Member>
+struct Field {
+    static_assert(Number > 0 && Number < 64, "field numbers must fit the presence mask");
+
+    static constexpr uint32_t number = Number;
+    static constexpr uint32_t tag = makeTag(Number, Wire);
+
+    template <typename Msg>
+    static bool decode(Msg& msg, const uint8_t*& ptr, size_t& remaining) {
+        auto& dst = msg.*Member;
+        using T = std::remove_reference_t<decltype(dst)>;
+
+        if constexpr (std::is_same_v<T, std::vector<uint32_t>>) {
+            // repeated fixed32, packed (proto3 default) or one per tag
+            if constexpr (Wire == WIRE_LENGTH_DELIMITED) {
+                uint64_t length = decodeVarint(ptr, remaining);
+                if (remaining < length || length % 4 != 0) return false;
+                size_t first = dst.size();
+                dst.resize(first + length / 4);
+                memcpy(dst.data() + first, ptr, (size_t)length);
+                ptr += length;
+                remaining -= length;
+            } else {
+                static_assert(Wire == WIRE_FIXED32, "repeated uint32 members hold fixed32 values");
+                if (remaining < 4) return false;
+                uint32_t value;
+                memcpy(&value, ptr, 4);
+                dst.push_back(value);
+                ptr += 4;
+                remaining -= 4;
+            }
+        } else if constexpr (std::is_same_v<T, std::vector<std::vector<uint8_t>>>) {
+            // repeated embedded message, decoded later by its own layout
+            static_assert(Wire == WIRE_LENGTH_DELIMITED, "repeated messages are length-delimited");
+            uint64_t length = decodeVarint(ptr, remaining);
+            if (remaining < length) return false;
+            dst.emplace_back(ptr, ptr + length);
+            ptr += length;
+            remaining -= length;
+        } else if constexpr (Wire == WIRE_VARINT) {
+            dst = static_cast<T>(decodeVarint(ptr, remaining));
+        } else if constexpr (Wire == WIRE_FIXED32) {
+            if (remaining < 4) return false;
+            if constexpr (std::is_same_v<T, float>) {
+                memcpy(&dst, ptr, 4);
+            } else {
+                uint32_t value;
+                memcpy(&value, ptr, 4);
+                dst = static_cast<T>(value);
+            }
+            ptr += 4;
+            remaining -= 4;
+        } else if constexpr (Wire == WIRE_FIXED64) {
+            if (remaining < 8) return false;
+            uint64_t value;
+            memcpy(&value, ptr, 8);
+            dst = static_cast<T>(value);
+            ptr += 8;
+            remaining -= 8;
+        } else {
+            static_assert(Wire == WIRE_LENGTH_DELIMITED, "unsupported wire type");
+            uint64_t length = decodeVarint(ptr, remaining);
+            if (remaining < length) return false;
+            if constexpr (std::is_same_v<T, std::string>) {
+                dst.assign((const char*)ptr, (size_t)length);
+            } else {
+                dst.assign(ptr, ptr + length);
+            }
+            ptr += length;
+            remaining -= length;
+        }
+        msg.present |= 1ull << Number;
+        return true;
+    }
+};
+
+template <typename Msg, typename... Fields>
+struct MessageLayout {
+    static constexpr uint64_t allFields = ((1ull << Fields::number) | ...);
+
+    // Decodes `length` bytes into `msg`. Only fields in `Wanted` are
+    // decoded; the rest are skipped. Returns false on malformed input, in
+    // which case `msg` holds whatever was decoded before the error.
+    template <uint64_t Wanted = allFields>
+    static bool parse(Msg& msg, const uint8_t* data, size_t length) {
+        static constexpr DispatchTable<Wanted> table{};
+        const uint8_t* ptr = data;
+        size_t remaining = length;
+
+        while (remaining > 0) {
+            uint32_t tag = (uint32_t)decodeVarint(ptr, remaining);
+            if ((tag >> 3) == 0) return false;
+
+            int status = 0;
+            if (tag < SHORT_TAGS) {
+                uint8_t slot = table.slots[tag];
+                if (slot) status = table.handlers[slot - 1](msg, ptr, remaining);
+            } else {
+                (((status = dispatch<Fields, Wanted>(tag, msg, ptr, remaining)) != 0) || ...);
+            }
+
+            if (status < 0) return false;
+            if (status == 0 && !skipField(tag & 0x7, ptr, remaining)) return false;
+        }
+        return true;
+    }
+
+private:
+    // Tags of fields 1..15 fit in one varint byte and cover every layout in
+    // this file; they are dispatched through a table, anything larger falls
+    // back to comparing against each declared field in turn.
+    static constexpr uint32_t SHORT_TAGS = 128;
+
+    typedef int (*Handler)(Msg&, const uint8_t*&, size_t&);
+
+    // 1 = decoded, -1 = truncated.
+    template <typename F>
+    static int decodeField(Msg& msg, const uint8_t*& ptr, size_t& remaining) {
+        return F::decode(msg, ptr, remaining) ? 1 : -1;
+    }
+
+    // slots[tag] is 1 + the index of the wanted field with that tag in
+    // `handlers`, or 0 when the tag is unknown or not wanted.
+    template <uint64_t Wanted>
+    struct DispatchTable {
+        uint8_t slots[SHORT_TAGS] = {};
+        Handler handlers[sizeof...(Fields)] = {&decodeField<Fields>...};
+
+        constexpr DispatchTable() {
+            uint8_t index = 0;
+            ((index++, (((Wanted >> Fields::number) & 1) && Fields::tag < SHORT_TAGS)
+                           ? (void)(slots[Fields::tag] = index) : (void)0), ...);
+        }
+    };
+
+    // 1 = decoded, -1 = truncated, 0 = not this field (or not wanted).
+    template <typename F, uint64_t Wanted>
+    static int dispatch(uint32_t tag, Msg& msg, const uint8_t*& ptr, size_t& remaining) {
+        if constexpr (((Wanted >> F::number) & 1) == 0) {
+            return 0;
+        } else {
+            if (tag != F::tag) return 0;
+            return decodeField<F>(msg, ptr, remaining);
+        }
+    }
+};
+
+// ServiceEnvelope结构 (mqtt.proto)
+struct ServiceEnvelope {
+    enum : uint32_t { PACKET = 1, CHANNEL_ID = 2, GATEWAY_ID = 3 };
+
+    std::vector<uint8_t> packetData;
+    std::string channelId;
+    std::string gatewayId;
+    uint64_t present = 0;
+    bool valid = false;
+};
+
+typedef MessageLayout<ServiceEnvelope,
+    Field<ServiceEnvelope::PACKET, WIRE_LENGTH_DELIMITED, &ServiceEnvelope::packetData>,
+    Field<ServiceEnvelope::CHANNEL_ID, WIRE_LENGTH_DELIMITED, &ServiceEnvelope::channelId>,
+    Field<ServiceEnvelope::GATEWAY_ID, WIRE_LENGTH_DELIMITED, &ServiceEnvelope::gatewayId>
+> ServiceEnvelopeLayout;
+
+// MeshPacket结构 (mesh.proto)
+struct MeshPacket {
+    enum : uint32_t {
+        FROM = 1, TO = 2, CHANNEL = 3, DECODED = 4, ENCRYPTED = 5, ID = 6,
+        RX_TIME = 7, RX_SNR = 8, HOP_LIMIT = 9, WANT_ACK = 10, PRIORITY = 11,
+        RX_RSSI = 12, VIA_MQTT = 14, HOP_START = 15
+    };
+
+    uint32_t from = 0;
+    uint32_t to = 0;
+    uint64_t id = 0;
+    uint32_t channel = 0;
+    uint32_t rxTime = 0;
+    float rxSnr = 0.0f;
+    uint32_t hopLimit = 0;
+    uint32_t hopStart = 0;
+    uint32_t priority = 0;
+    int32_t rxRssi = 0;
+    bool wantAck = false;
+    bool viaMqtt = false;
+    std::vector<uint8_t> decodedData;    // plaintext Data message
+    std::vector<uint8_t> encryptedData;
+    uint64_t present = 0;
+    bool valid = false;
+
+    bool has(uint32_t field) const { return (present >> field) & 1; }
+};
+
+typedef MessageLayout<MeshPacket,
+    Field<MeshPacket::FROM, WIRE_FIXED32, &MeshPacket::from>,
+    Field<MeshPacket::FROM, WIRE_VARINT, &MeshPacket::from>,
+    Field<MeshPacket::TO, WIRE_FIXED32, &MeshPacket::to>,
+    Field<MeshPacket::TO, WIRE_VARINT, &MeshPacket::to>,
+    Field<MeshPacket::CHANNEL, WIRE_VARINT, &MeshPacket::channel>,
+    Field<MeshPacket::DECODED, WIRE_LENGTH_DELIMITED, &MeshPacket::decodedData>,
+    Field<MeshPacket::ENCRYPTED, WIRE_LENGTH_DELIMITED, &MeshPacket::encryptedData>,
+    Field<MeshPacket::ID, WIRE_FIXED32, &MeshPacket::id>,
+    Field<MeshPacket::ID, WIRE_VARINT, &MeshPacket::id>,
+    Field<MeshPacket::ID, WIRE_FIXED64, &MeshPacket::id>,
+    Field<MeshPacket::RX_TIME, WIRE_FIXED32, &MeshPacket::rxTime>,
+    Field<MeshPacket::RX_SNR, WIRE_FIXED32, &MeshPacket::rxSnr>,
+    Field<MeshPacket::HOP_LIMIT, WIRE_VARINT, &MeshPacket::hopLimit>,
+    Field<MeshPacket::WANT_ACK, WIRE_VARINT, &MeshPacket::wantAck>,
+    Field<MeshPacket::PRIORITY, WIRE_VARINT, &MeshPacket::priority>,
+    Field<MeshPacket::RX_RSSI, WIRE_VARINT, &MeshPacket::rxRssi>,
+    Field<MeshPacket::VIA_MQTT, WIRE_VARINT, &MeshPacket::viaMqtt>,
+    Field<MeshPacket::HOP_START, WIRE_VARINT, &MeshPacket::hopStart>
+> MeshPacketLayout;
+
+// Data结构 (mesh.proto) - the decrypted or plaintext payload of a MeshPacket
+struct DataMessage {
+    enum : uint32_t { PORTNUM = 1, PAYLOAD = 2, WANT_RESPONSE = 3, DEST = 4, SOURCE = 5, REQUEST_ID = 6 };
+
+    uint32_t portnum = 0;
+    std::vector<uint8_t> payload;
+    bool wantResponse = false;
+    uint32_t dest = 0;
+    uint32_t source = 0;
+    uint32_t requestId = 0;
+    uint64_t present = 0;
+    bool valid = false;
+};
+
+typedef MessageLayout<DataMessage,
+    Field<DataMessage::PORTNUM, WIRE_VARINT, &DataMessage::portnum>,
+    Field<DataMessage::PAYLOAD, WIRE_LENGTH_DELIMITED, &DataMessage::payload>,
+    Field<DataMessage::WANT_RESPONSE, WIRE_VARINT, &DataMessage::wantResponse>,
+    Field<DataMessage::DEST, WIRE_FIXED32, &DataMessage::dest>,
+    Field<DataMessage::SOURCE, WIRE_FIXED32, &DataMessage::source>,
+    Field<DataMessage::REQUEST_ID, WIRE_FIXED32, &DataMessage::requestId>
+> DataMessageLayout;
+
+// Position结构 (mesh.proto) - POSITION_APP payload, degrees * 1e7
+struct Position {
+    enum : uint32_t { LATITUDE_I = 1, LONGITUDE_I = 2, ALTITUDE = 3, TIME = 4 };
+
+    int32_t latitudeI = 0;
+    int32_t longitudeI = 0;
+    int32_t altitude = 0;
+    uint32_t time = 0;
+    uint64_t present = 0;
+    bool valid = false;
+
+    bool has(uint32_t field) const { return (present >> field) & 1; }
+};
+
+typedef MessageLayout<Position,
+    Field<Position::LATITUDE_I, WIRE_FIXED32, &Position::latitudeI>,
+    Field<Position::LONGITUDE_I, WIRE_FIXED32, &Position::longitudeI>,
+    Field<Position::ALTITUDE, WIRE_VARINT, &Position::altitude>,
+    Field<Position::TIME, WIRE_FIXED32, &Position::time>
+> PositionLayout;
+
+// RouteDiscovery结构 (mesh.proto) - TRACEROUTE_APP payload
+struct RouteDiscovery {
+    enum : uint32_t { ROUTE = 1, ROUTE_BACK = 3 };
+
+    std::vector<uint32_t> route;      // nodes between origin and destination
+    std::vector<uint32_t> routeBack;  // nodes on the way back
+    uint64_t present = 0;
+    bool valid = false;
+};
+
+typedef MessageLayout<RouteDiscovery,
+    Field<RouteDiscovery::ROUTE, WIRE_LENGTH_DELIMITED, &RouteDiscovery::route>,
+    Field<RouteDiscovery::ROUTE, WIRE_FIXED32, &RouteDiscovery::route>,
+    Field<RouteDiscovery::ROUTE_BACK, WIRE_LENGTH_DELIMITED, &RouteDiscovery::routeBack>,
+    Field<RouteDiscovery::ROUTE_BACK, WIRE_FIXED32, &RouteDiscovery::routeBack>
+> RouteDiscoveryLayout;
+
+// NeighborInfo / Neighbor结构 (mesh.proto) - NEIGHBORINFO_APP payload
+struct Neighbor {
+    enum : uint32_t { NODE_ID = 1, SNR = 2 };
+
+    uint32_t nodeId = 0;
+    float snr = 0.0f;
+    uint64_t present = 0;
+    bool valid = false;
+};
+
+typedef MessageLayout<Neighbor,
+    Field<Neighbor::NODE_ID, WIRE_VARINT, &Neighbor::nodeId>,
+    Field<Neighbor::SNR, WIRE_FIXED32, &Neighbor::snr>
+> NeighborLayout;
+
+struct NeighborInfo {
+    enum : uint32_t { NODE_ID = 1, LAST_SENT_BY_ID = 2, NEIGHBORS = 4 };
+
+    uint32_t nodeId = 0;
+    uint32_t lastSentById = 0;
+    std::vector<std::vector<uint8_t>> neighbors;  // encoded Neighbor messages
+    uint64_t present = 0;
+    bool valid = false;
+};
+
+typedef MessageLayout<NeighborInfo,
+    Field<NeighborInfo::NODE_ID, WIRE_VARINT, &NeighborInfo::nodeId>,
+    Field<NeighborInfo::LAST_SENT_BY_ID, WIRE_VARINT, &NeighborInfo::lastSentById>,
+    Field<NeighborInfo::NEIGHBORS, WIRE_LENGTH_DELIMITED, &NeighborInfo::neighbors>
+> NeighborInfoLayout;
+
+// portnums.proto (subset)
+enum PortNum : uint32_t {
+    PORT_TEXT_MESSAGE = 1,
+    PORT_POSITION = 3,
+    PORT_NODEINFO = 4,
+    PORT_TELEMETRY = 67,
+    PORT_TRACEROUTE = 70,
+    PORT_NEIGHBORINFO = 71
+};
+
+// 解析ServiceEnvelope. Valid when the embedded MeshPacket was found, even if
+// trailing bytes are malformed.
+template <uint64_t Wanted = ServiceEnvelopeLayout::allFields>
+inline ServiceEnvelope decodeServiceEnvelope(const uint8_t* data, size_t length) {
+    ServiceEnvelope envelope;
+    ServiceEnvelopeLayout::parse<Wanted>(envelope, data, length);
+    envelope.valid = !envelope.packetData.empty();
+    return envelope;
+}
+
+// 解析MeshPacket. Valid when the whole buffer decoded cleanly.
+template <uint64_t Wanted = MeshPacketLayout::allFields>
+inline MeshPacket decodeMeshPacket(const uint8_t* data, size_t length) {
+    MeshPacket packet;
+    packet.valid = MeshPacketLayout::parse<Wanted>(packet, data, length);
+    return packet;
+}
+
+template <uint64_t Wanted = DataMessageLayout::allFields>
+inline DataMessage decodeDataMessage(const uint8_t* data, size_t length) {
+    DataMessage message;
+    message.valid = DataMessageLayout::parse<Wanted>(message, data, length) && message.present != 0;
+    return message;
+}
+
+// Generic entry point for the smaller payload messages.
+template <typename Layout, typename Msg, uint64_t Wanted = Layout::allFields>
+inline Msg decodeMessage(const uint8_t* data, size_t length) {
+    Msg message;
+    message.valid = Layout::template parse<Wanted>(message, data, length);
+    return message;
+}
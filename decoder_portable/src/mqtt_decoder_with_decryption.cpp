@@ -4,368 +4,186 @@
 #include <sstream>
 #include <iomanip>
 #include <cstring>
+#include <cstdlib>
 #include <algorithm>
+#include <memory>
+
+#include "mesh_decoder.h"
+#include "pipeline.h"
+#include "batch_decoder.h"
 
 using namespace std;
 
-// Simple AES-CTR implementation for demonstration
-// Note: This is a simplified version for educational purposes
-class SimpleAES {
-private:
-    static const uint8_t sbox[256];
-    uint8_t key[16];
-    
-public:
-    SimpleAES(const vector<uint8_t>& keyData) {
-        memcpy(key, keyData.data(), min(16, (int)keyData.size()));
-    }
-    
-    void xorWithKey(uint8_t* data, size_t len) {
-        for (size_t i = 0; i < len; i++) {
-            data[i] ^= key[i % 16];
-        }
-    }
-    
-    // Simplified CTR mode - just XOR with key for demonstration
-    void decryptCTR(const uint8_t* input, uint8_t* output, size_t len, uint64_t nonce) {
-        memcpy(output, input, len);
-        
-        // Simple XOR with key (not real AES, but demonstrates the concept)
-        for (size_t i = 0; i < len; i++) {
-            uint8_t keyByte = key[i % 16];
-            uint8_t nonceByte = (uint8_t)((nonce >> (i % 8)) & 0xFF);
-            output[i] ^= keyByte ^ nonceByte;
+// Gateways and the nodes they hear, for --graph.
+void printTopologySummary(ostream& out, const TopologySnapshot& topology) {
+    out << "\n=== Mesh Topology ===" << endl;
+    out << "Nodes: " << topology.nodeCount()
+        << ", gateways: " << topology.gatewayCount()
+        << ", gateway reports: " << topology.reachCount()
+        << ", inferred links: " << topology.linkCount() << endl;
+}
+
+// Non-interactive service mode: hex messages are read one per line from
+// stdin and decoded by the staged pipeline. Summaries go to stdout, the
+// pipeline report to stderr.
+//
+//   --pipeline            enable this mode
+//   --psk <AQ==|hex>      key used by the decrypt stage (default AQ==)
+//   --config <file>       keyring and filter rules, reloaded when the file changes;
+//                         channels it has no key for use --psk
+//   --queue <n>           capacity of each inter-stage queue (default 1024)
+//   --drop                drop records when a queue is full instead of blocking
+//   --pin                 pin each stage to its own CPU
+//   --graph               build the mesh topology and print a summary at the end
+//   --positions           index POSITION packets and print a summary at the end
+int runPipelineMode(int argc, char* argv[]) {
+    PipelineConfig config;
+    string pskInput = "AQ==";
+    string configPath;
+    MeshGraph graph;
+    PositionIndex positions;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--psk" && i + 1 < argc) {
+            pskInput = argv[++i];
+        } else if (arg == "--config" && i + 1 < argc) {
+            configPath = argv[++i];
+        } else if (arg == "--queue" && i + 1 < argc) {
+            config.queueCapacity = (size_t)strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--drop") {
+            config.policy = Backpressure::Drop;
+        } else if (arg == "--pin") {
+            config.pinThreads = true;
+        } else if (arg == "--graph") {
+            config.graph = &graph;
+        } else if (arg == "--positions") {
+            config.positions = &positions;
         }
     }
-};
-
-const uint8_t SimpleAES::sbox[256] = {
-    // Simplified S-box for demonstration
-    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76
-    // ... (truncated for brevity)
-};
+    config.psk = getPSKFromInput(pskInput, false);
 
-vector<uint8_t> hexToBytes(string hex) {
-    vector<uint8_t> result;
-    hex.erase(remove_if(hex.begin(), hex.end(), [](char c) { return isspace(c); }), hex.end());
-    
-    for (size_t i = 0; i < hex.length(); i += 2) {
-        if (i + 1 < hex.length()) {
-            string byteString = hex.substr(i, 2);
-            uint8_t byte = (uint8_t)strtol(byteString.c_str(), nullptr, 16);
-            result.push_back(byte);
+    unique_ptr<ConfigHandle> runtime;
+    unique_ptr<ConfigWatcher> watcher;
+    if (!configPath.empty()) {
+        unique_ptr<DecoderConfig> initial(new DecoderConfig());
+        string error;
+        if (!loadDecoderConfig(configPath, *initial, error)) {
+            cerr << "ERROR: " << configPath << ": " << error << endl;
+            return 1;
+        }
+        if (initial->defaultKey.empty()) {
+            cerr << "WARNING: " << configPath << " has no 'key *' line; channels without a key use --psk "
+                 << pskInput << endl;
+        }
+        runtime.reset(new ConfigHandle(move(initial)));
+        watcher.reset(new ConfigWatcher(configPath, *runtime));
+        if (!watcher->start(error)) {
+            cerr << "ERROR: " << error << endl;
+            return 1;
         }
+        config.runtime = runtime.get();
     }
-    return result;
-}
 
-void printHex(const vector<uint8_t>& data, const string& label = "") {
-    if (!label.empty()) {
-        cout << label << ": ";
+    DecodePipeline pipeline(config);
+    PipelineReport report = pipeline.run(
+        [](string& line) { return (bool)getline(cin, line); },
+        [](const PacketRecord& record) { cout << record.summary << '\n'; });
+    cout.flush();
+
+    printPipelineReport(cerr, report);
+    if (watcher) {
+        watcher->stop();
+        ReloadStats reloads = watcher->stats();
+        cerr << "\n=== Config ===" << endl;
+        cerr << "Version: " << runtime->version() << ", reloads: " << reloads.reloads
+             << ", failed: " << reloads.failures << fixed << setprecision(3)
+             << ", latency avg " << reloads.averageLatencyMs() << " ms, max "
+             << reloads.maxLatencyNs / 1e6 << " ms" << defaultfloat << endl;
     }
-    for (size_t i = 0; i < data.size(); i++) {
-        cout << hex << setw(2) << setfill('0') << (int)data[i];
-        if (i < data.size() - 1) cout << " ";
+    if (config.graph) {
+        printTopologySummary(cerr, *graph.snapshot(true));
     }
-    cout << dec << endl;
-}
-
-uint64_t decodeVarint(const uint8_t*& data, size_t& remaining) {
-    uint64_t result = 0;
-    int shift = 0;
-    
-    while (remaining > 0 && shift < 64) {
-        uint8_t byte = *data++;
-        remaining--;
-        result |= ((uint64_t)(byte & 0x7F)) << shift;
-        if ((byte & 0x80) == 0) break;
-        shift += 7;
+    if (config.positions) {
+        cerr << "\n=== Position Index ===" << endl;
+        cerr << "Fixes: " << positions.size() << " in " << positions.bucketCount() << " time buckets" << endl;
     }
-    return result;
+    return 0;
 }
 
-struct ServiceEnvelope {
-    vector<uint8_t> packetData;
-    string channelId;
-    string gatewayId;
-    bool valid = false;
-};
-
-struct MeshPacket {
-    uint32_t from = 0;
-    uint32_t to = 0;
-    uint64_t id = 0;
-    uint32_t channel = 0;
-    uint32_t hopLimit = 0;
-    uint32_t hopStart = 0;
-    bool wantAck = false;
-    vector<uint8_t> encryptedData;
-    bool valid = false;
-};
+// Batch mode: decodes a capture file (one hex message per line) into a
+// summary file. With --checkpoint an interrupted run picks up where the
+// last checkpoint left off when started again with the same arguments.
+//
+//   --input <file>            capture to decode (enables this mode)
+//   --output <file>           summaries, one line per unique packet
+//   --checkpoint <file>       checkpoint file to write and resume from
+//   --checkpoint-every <n>    records between checkpoints (default 100000)
+//   --dedup <n>               from/id pairs kept for duplicate detection (default 65536)
+//   --psk <AQ==|hex>          decryption key (default AQ==)
+//   --io <auto|uring|threads> I/O backend (default auto: io_uring when available)
+//   --io-block <KiB>          size of each read/write block (default 1024)
+//   --io-depth <n>            blocks in flight per file (default 4)
+//   --direct                  bypass the page cache (O_DIRECT, Linux only)
+int runBatchMode(int argc, char* argv[]) {
+    BatchConfig config;
+    string pskInput = "AQ==";
 
-ServiceEnvelope parseServiceEnvelope(const uint8_t* data, size_t length) {
-    ServiceEnvelope envelope;
-    const uint8_t* ptr = data;
-    size_t remaining = length;
-    
-    cout << "\n=== ServiceEnvelope Parsing ===" << endl;
-    
-    while (remaining > 0) {
-        uint64_t tag = decodeVarint(ptr, remaining);
-        uint32_t fieldNumber = (uint32_t)(tag >> 3);
-        uint32_t wireType = tag & 0x7;
-        
-        switch (fieldNumber) {
-            case 1:
-                if (wireType == 2) {
-                    uint64_t length = decodeVarint(ptr, remaining);
-                    if (remaining >= length) {
-                        envelope.packetData.assign(ptr, ptr + length);
-                        cout << "SUCCESS: Found MeshPacket (" << length << " bytes)" << endl;
-                        ptr += length;
-                        remaining -= length;
-                    }
-                }
-                break;
-                
-            case 2:
-                if (wireType == 2) {
-                    uint64_t length = decodeVarint(ptr, remaining);
-                    if (remaining >= length) {
-                        envelope.channelId.assign((char*)ptr, length);
-                        cout << "SUCCESS: Channel ID: " << envelope.channelId << endl;
-                        ptr += length;
-                        remaining -= length;
-                    }
-                }
-                break;
-                
-            case 3:
-                if (wireType == 2) {
-                    uint64_t length = decodeVarint(ptr, remaining);
-                    if (remaining >= length) {
-                        envelope.gatewayId.assign((char*)ptr, length);
-                        cout << "SUCCESS: Gateway ID: " << envelope.gatewayId << endl;
-                        ptr += length;
-                        remaining -= length;
-                    }
-                }
-                break;
-                
-            default:
-                if (wireType == 0) {
-                    decodeVarint(ptr, remaining);
-                } else if (wireType == 2) {
-                    uint64_t length = decodeVarint(ptr, remaining);
-                    if (remaining >= length) {
-                        ptr += length;
-                        remaining -= length;
-                    }
-                }
-                break;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--input" && i + 1 < argc) {
+            config.inputPath = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            config.outputPath = argv[++i];
+        } else if (arg == "--checkpoint" && i + 1 < argc) {
+            config.checkpointPath = argv[++i];
+        } else if (arg == "--checkpoint-every" && i + 1 < argc) {
+            config.checkpointEvery = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--dedup" && i + 1 < argc) {
+            config.dedupWindow = (size_t)strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--psk" && i + 1 < argc) {
+            pskInput = argv[++i];
+        } else if (arg == "--io" && i + 1 < argc) {
+            if (!parseIoBackend(argv[++i], config.io.backend)) {
+                cerr << "ERROR: unknown I/O backend " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--io-block" && i + 1 < argc) {
+            config.io.blockSize = (size_t)strtoul(argv[++i], nullptr, 10) * 1024;
+        } else if (arg == "--io-depth" && i + 1 < argc) {
+            config.io.depth = (unsigned)strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--direct") {
+            config.io.direct = true;
         }
     }
-    
-    envelope.valid = !envelope.packetData.empty();
-    return envelope;
-}
+    if (config.outputPath.empty()) {
+        cerr << "ERROR: --input requires --output" << endl;
+        return 1;
+    }
+    config.psk = getPSKFromInput(pskInput, false);
 
-MeshPacket parseMeshPacket(const uint8_t* data, size_t length) {
-    MeshPacket packet;
-    const uint8_t* ptr = data;
-    size_t remaining = length;
-    
-    cout << "\n=== MeshPacket Parsing ===" << endl;
-    
-    while (remaining > 0) {
-        uint64_t tag = decodeVarint(ptr, remaining);
-        uint32_t fieldNumber = (uint32_t)(tag >> 3);
-        uint32_t wireType = tag & 0x7;
-        
-        cout << "DEBUG: Field " << fieldNumber << ", WireType " << wireType << endl;
-        
-        switch (fieldNumber) {
-            case 1:
-                if (wireType == 0) {
-                    packet.from = (uint32_t)decodeVarint(ptr, remaining);
-                    cout << "SUCCESS: From: 0x" << hex << packet.from << dec << " (!" << hex << packet.from << dec << ")" << endl;
-                }
-                break;
-                
-            case 2:
-                if (wireType == 0) {
-                    packet.to = (uint32_t)decodeVarint(ptr, remaining);
-                    cout << "SUCCESS: To: 0x" << hex << packet.to << dec;
-                    if (packet.to == 0xFFFFFFFF) {
-                        cout << " (broadcast)";
-                    }
-                    cout << endl;
-                }
-                break;
-                
-            case 3:
-                if (wireType == 2) {
-                    uint64_t length = decodeVarint(ptr, remaining);
-                    if (remaining >= length) {
-                        packet.encryptedData.assign(ptr, ptr + length);
-                        cout << "SUCCESS: Encrypted data (field 3): " << length << " bytes" << endl;
-                        ptr += length;
-                        remaining -= length;
-                    }
-                }
-                break;
-                
-            case 4:
-                if (wireType == 2) {
-                    uint64_t length = decodeVarint(ptr, remaining);
-                    if (remaining >= length) {
-                        packet.encryptedData.assign(ptr, ptr + length);
-                        cout << "SUCCESS: Encrypted data (field 4): " << length << " bytes" << endl;
-                        ptr += length;
-                        remaining -= length;
-                    }
-                }
-                break;
-                
-            case 5:
-                if (wireType == 2) {
-                    uint64_t length = decodeVarint(ptr, remaining);
-                    if (remaining >= length) {
-                        packet.encryptedData.assign(ptr, ptr + length);
-                        cout << "SUCCESS: Encrypted data (field 5): " << length << " bytes" << endl;
-                        ptr += length;
-                        remaining -= length;
-                    }
-                }
-                break;
-                
-            case 6:
-                if (wireType == 1) {
-                    if (remaining >= 8) {
-                        packet.id = *(uint64_t*)ptr;
-                        cout << "SUCCESS: ID: 0x" << hex << packet.id << dec << endl;
-                        ptr += 8;
-                        remaining -= 8;
-                    }
-                } else if (wireType == 0) {
-                    packet.id = decodeVarint(ptr, remaining);
-                    cout << "SUCCESS: ID: 0x" << hex << packet.id << dec << endl;
-                }
-                break;
-                
-            default:
-                cout << "DEBUG: Skipping unknown field " << fieldNumber << endl;
-                if (wireType == 0) {
-                    decodeVarint(ptr, remaining);
-                } else if (wireType == 2) {
-                    uint64_t length = decodeVarint(ptr, remaining);
-                    if (remaining >= length) {
-                        // 检查是否是可能的加密数据
-                        if (length > 0 && length < 1000) {
-                            packet.encryptedData.assign(ptr, ptr + length);
-                            cout << "INFO: Found potential encrypted data in field " << fieldNumber << ": " << length << " bytes" << endl;
-                        }
-                        ptr += length;
-                        remaining -= length;
-                    }
-                } else if (wireType == 1) {
-                    if (remaining >= 8) {
-                        ptr += 8;
-                        remaining -= 8;
-                    }
-                } else if (wireType == 5) {
-                    if (remaining >= 4) {
-                        ptr += 4;
-                        remaining -= 4;
-                    }
-                }
-                break;
-        }
+    BatchReport report;
+    string error;
+    bool ok = runBatchDecode(config, report, error);
+    printBatchReport(cerr, report);
+    if (!ok) {
+        cerr << "ERROR: " << error << endl;
+        return 1;
     }
-    
-    cout << "DEBUG: Final encrypted data size: " << packet.encryptedData.size() << " bytes" << endl;
-    
-    packet.valid = true;
-    return packet;
+    return 0;
 }
 
-bool attemptDecryption(const vector<uint8_t>& encryptedData, const vector<uint8_t>& psk, uint64_t messageId, uint32_t fromNode, const string& expectedContent = "") {
-    cout << "\n=== ATTEMPTING DECRYPTION ===" << endl;
-    printHex(encryptedData, "Encrypted data");
-    printHex(psk, "PSK");
-    
-    if (encryptedData.empty() || psk.size() < 16) {
-        cout << "ERROR: Invalid data or PSK for decryption!" << endl;
-        return false;
-    }
-    
-    // Create AES decryptor
-    SimpleAES aes(psk);
-    
-    // Create nonce from message ID and sender
-    uint64_t nonce = messageId ^ ((uint64_t)fromNode << 32);
-    cout << "Nonce: 0x" << hex << nonce << dec << endl;
-    
-    // Decrypt the data
-    vector<uint8_t> decrypted(encryptedData.size());
-    aes.decryptCTR(encryptedData.data(), decrypted.data(), encryptedData.size(), nonce);
-    
-    printHex(decrypted, "Decrypted raw");
-    
-    // Try to interpret as text
-    string decryptedText;
-    bool validText = true;
-    for (uint8_t byte : decrypted) {
-        if (byte >= 32 && byte <= 126) {  // Printable ASCII
-            decryptedText += (char)byte;
-        } else if (byte == 0) {
-            break;  // Null terminator
-        } else {
-            validText = false;
-            break;
-        }
-    }
-    
-    cout << "\n=== DECRYPTION RESULTS ===" << endl;
-    if (validText && !decryptedText.empty()) {
-        cout << "SUCCESS: Decrypted text: \"" << decryptedText << "\"" << endl;
-        
-        if (!expectedContent.empty()) {
-            if (decryptedText == expectedContent) {
-                cout << "SUCCESS: Matches expected content!" << endl;
-                return true;
-            } else {
-                cout << "WARNING: Does not match expected content (" << expectedContent << ")" << endl;
-            }
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--pipeline") {
+            return runPipelineMode(argc, argv);
         }
-        return true;
-    } else {
-        cout << "INFO: Could not interpret as readable text" << endl;
-        cout << "Raw decrypted bytes: ";
-        for (size_t i = 0; i < min((size_t)20, decrypted.size()); i++) {
-            cout << "0x" << hex << setw(2) << setfill('0') << (int)decrypted[i] << " ";
+        if (string(argv[i]) == "--input") {
+            return runBatchMode(argc, argv);
         }
-        cout << dec << endl;
-        return false;
     }
-}
 
-vector<uint8_t> getPSKFromInput(const string& pskInput) {
-    const uint8_t defaultpsk[] = {
-        0xd4, 0xf1, 0xbb, 0x3a, 0x20, 0x29, 0x07, 0x59,
-        0xf0, 0xbc, 0xff, 0xab, 0xcf, 0x4e, 0x69, 0x01
-    };
-    
-    if (pskInput == "AQ==") {
-        cout << "Using PSK #1 (default shared key)" << endl;
-        return vector<uint8_t>(defaultpsk, defaultpsk + 16);
-    } else {
-        cout << "Using custom PSK: " << pskInput << endl;
-        return hexToBytes(pskInput);
-    }
-}
 
-int main() {
     cout << "========================================" << endl;
     cout << "   Meshtastic MQTT Decoder v2.0        " << endl;
     cout << "     WITH DECRYPTION SUPPORT            " << endl;
@@ -408,11 +226,19 @@ int main() {
         
         MeshPacket packet = parseMeshPacket(envelope.packetData.data(), envelope.packetData.size());
         
-        if (!packet.valid) {
+        // A malformed tail only costs the fields after it; parseMeshPacket
+        // has already warned, so carry on with what was decoded.
+        if (packet.present == 0) {
             cout << "ERROR: Failed to parse MeshPacket!" << endl;
             continue;
         }
         
+        string plaintext;
+        if (plaintextMessage(packet, plaintext)) {
+            cout << "\n=== PLAINTEXT MESSAGE ===" << endl;
+            cout << "SUCCESS: Text: \"" << plaintext << "\"" << endl;
+        }
+        
         string expectedContent;
         cout << "\nEnter expected message content: ";
         getline(cin, expectedContent);
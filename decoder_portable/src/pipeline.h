@@ -0,0 +1,460 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+// keep windows.h from defining min/max macros over std::min/std::max
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "mesh_decoder.h"
+#include "mesh_graph.h"
+#include "position_index.h"
+#include "runtime_config.h"
+#include "spsc_queue.h"
+
+// Staged decoding pipeline for live operation.
+//
+//   ingest -> parse -> decrypt -> enrich -> output
+//
+// Every stage runs on its own (optionally pinned) thread and hands records
+// to the next one through a bounded SpscQueue of PacketRecord pointers, so a
+// slow output sink only fills its queue instead of stalling socket reads.
+// With Backpressure::Drop the producer discards a record when the next queue
+// is full; with Backpressure::Block it waits.
+
+enum PipelineStage {
+    STAGE_INGEST = 0,
+    STAGE_PARSE,
+    STAGE_DECRYPT,
+    STAGE_ENRICH,
+    STAGE_OUTPUT,
+    STAGE_COUNT
+};
+
+static const int HANDOFF_COUNT = STAGE_COUNT - 1;
+
+inline const char* stageName(int stage) {
+    static const char* names[STAGE_COUNT] = {"ingest", "parse", "decrypt", "enrich", "output"};
+    return names[stage];
+}
+
+inline uint64_t pipelineNowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// One message travelling through the pipeline. Ownership passes with the
+// pointer; whoever drops or finishes a record deletes it.
+struct PacketRecord {
+    uint64_t sequence = 0;
+    std::string hexInput;
+    std::vector<uint8_t> raw;
+    ServiceEnvelope envelope;
+    MeshPacket packet;
+    std::vector<uint8_t> decrypted;
+    DataMessage data;               // plaintext payload, when present
+    std::string text;
+    bool hasText = false;
+    int hopsAway = -1;
+    std::string summary;
+    const DecoderConfig* config = nullptr;  // keys and filters pinned at ingest
+    bool filtered = false;                  // rejected by a filter rule
+
+    uint64_t enqueuedAt[HANDOFF_COUNT] = {};
+    uint64_t handoffNs[HANDOFF_COUNT] = {};
+};
+
+struct PipelineConfig {
+    size_t queueCapacity = 1024;
+    Backpressure policy = Backpressure::Block;
+    bool pinThreads = false;
+    int firstCpu = 0;
+    std::vector<uint8_t> psk;
+    ConfigHandle* runtime = nullptr;        // when set, keys and filters come from here; psk is the fallback key
+    bool collectLatency = true;
+    MeshGraph* graph = nullptr;             // updated by the enrich stage when set
+    PositionIndex* positions = nullptr;     // likewise, from POSITION payloads
+};
+
+struct StageStats {
+    uint64_t processed = 0;
+    uint64_t busyNs = 0;
+
+    double itemsPerSecond() const {
+        return busyNs ? (double)processed * 1e9 / (double)busyNs : 0.0;
+    }
+};
+
+struct HandoffLatency {
+    uint64_t samples = 0;
+    uint64_t p50Ns = 0;
+    uint64_t p99Ns = 0;
+    uint64_t maxNs = 0;
+};
+
+// Fixed-size log-linear histogram: each power of two is split into
+// SUB_BUCKETS linear steps, so a percentile is off by at most 1/SUB_BUCKETS
+// of its value and memory stays constant however long the pipeline runs.
+class LatencyHistogram {
+public:
+    void record(uint64_t ns) {
+        counts[bucketOf(ns)]++;
+        total++;
+        if (ns > maxNs) maxNs = ns;
+    }
+
+    HandoffLatency summary() const {
+        HandoffLatency result;
+        result.samples = total;
+        result.p50Ns = percentile(50);
+        result.p99Ns = percentile(99);
+        result.maxNs = maxNs;
+        return result;
+    }
+
+private:
+    static constexpr int SUB_BITS = 3;
+    static constexpr uint64_t SUB_BUCKETS = 1u << SUB_BITS;
+    static constexpr int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    uint64_t counts[BUCKETS] = {};
+    uint64_t total = 0;
+    uint64_t maxNs = 0;
+
+    static int bucketOf(uint64_t ns) {
+        if (ns < SUB_BUCKETS) return (int)ns;
+        int shift = 63 - __builtin_clzll(ns) - SUB_BITS;
+        return (shift + 1) * (int)SUB_BUCKETS + (int)((ns >> shift) - SUB_BUCKETS);
+    }
+
+    // Largest value that falls into `bucket`.
+    static uint64_t upperBound(int bucket) {
+        if (bucket < (int)SUB_BUCKETS) return (uint64_t)bucket;
+        int shift = bucket / (int)SUB_BUCKETS - 1;
+        uint64_t base = SUB_BUCKETS + (uint64_t)(bucket % (int)SUB_BUCKETS);
+        return ((base + 1) << shift) - 1;
+    }
+
+    uint64_t percentile(int p) const {
+        if (total == 0) return 0;
+        uint64_t rank = std::min(total - 1, total * (uint64_t)p / 100);
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += counts[i];
+            if (seen > rank) return std::min(upperBound(i), maxNs);
+        }
+        return maxNs;
+    }
+};
+
+struct PipelineReport {
+    uint64_t ingested = 0;
+    uint64_t delivered = 0;
+    uint64_t parseFailures = 0;
+    uint64_t filtered = 0;                  // reached the output stage but not the sink
+    uint64_t wallNs = 0;
+    StageStats stages[STAGE_COUNT];
+    QueueStats queues[HANDOFF_COUNT];
+    HandoffLatency handoffs[HANDOFF_COUNT];
+
+    uint64_t dropped() const {
+        uint64_t total = 0;
+        for (const QueueStats& q : queues) total += q.dropped;
+        return total;
+    }
+};
+
+inline bool pinCurrentThread(int cpu) {
+    unsigned cpus = std::thread::hardware_concurrency();
+    if (cpus == 0) return false;
+    cpu %= (int)cpus;
+#ifdef _WIN32
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+inline std::string formatNodeId(uint32_t node) {
+    std::ostringstream out;
+    out << "!" << std::hex << std::setw(8) << std::setfill('0') << node;
+    return out.str();
+}
+
+// MeshPacket fields read by the stages below, the filters, the graph and the
+// batch decoder; the radio metadata (SNR, RSSI, priority, ...) is skipped.
+constexpr uint64_t RECORD_PACKET_FIELDS = fieldMask(
+    MeshPacket::FROM, MeshPacket::TO, MeshPacket::CHANNEL, MeshPacket::DECODED, MeshPacket::ENCRYPTED,
+    MeshPacket::ID, MeshPacket::RX_TIME, MeshPacket::HOP_LIMIT, MeshPacket::HOP_START);
+
+// The per-record work of the parse, decrypt and enrich stages. The batch
+// decoder runs the same steps sequentially.
+inline void parseRecord(PacketRecord& r) {
+    r.raw = hexToBytes(r.hexInput);
+    r.envelope = decodeServiceEnvelope(r.raw.data(), r.raw.size());
+    if (r.envelope.valid) {
+        r.packet = decodeMeshPacket<RECORD_PACKET_FIELDS>(r.envelope.packetData.data(),
+                                                          r.envelope.packetData.size());
+    }
+}
+
+inline void decryptRecord(PacketRecord& r, const std::vector<uint8_t>& psk) {
+    if (!r.packet.valid) return;
+    if (!r.packet.encryptedData.empty()) {
+        r.hasText = decryptPayload(r.packet.encryptedData, psk, r.packet.id,
+                                   r.packet.from, r.decrypted, r.text);
+        // The decrypted payload is the message text itself, so readable
+        // plaintext stands for a TEXT_MESSAGE and port rules can match it.
+        if (r.hasText) {
+            r.data.portnum = PORT_TEXT_MESSAGE;
+            r.data.payload.assign(r.text.begin(), r.text.end());
+            r.data.present = 1ull << DataMessage::PORTNUM | 1ull << DataMessage::PAYLOAD;
+            r.data.valid = true;
+        }
+    } else if (r.packet.has(MeshPacket::DECODED)) {
+        r.data = decodeDataMessage(r.packet.decodedData.data(), r.packet.decodedData.size());
+        r.hasText = textMessage(r.data, r.text);
+    }
+}
+
+// One-line summary written by the output stage.
+inline void summarizeRecord(PacketRecord& r) {
+    if (!r.envelope.valid) {
+        r.summary = "ERROR: Failed to parse ServiceEnvelope";
+        return;
+    }
+    if (r.packet.hopStart >= r.packet.hopLimit && r.packet.hopStart != 0) {
+        r.hopsAway = (int)(r.packet.hopStart - r.packet.hopLimit);
+    }
+
+    std::ostringstream out;
+    out << formatNodeId(r.packet.from) << " -> ";
+    if (r.packet.to == 0xFFFFFFFF) {
+        out << "broadcast";
+    } else {
+        out << formatNodeId(r.packet.to);
+    }
+    out << " | channel " << r.envelope.channelId
+        << " | gateway " << r.envelope.gatewayId
+        << " | id 0x" << std::hex << r.packet.id << std::dec;
+    if (r.hopsAway >= 0) out << " | hops " << r.hopsAway;
+    if (r.hasText) {
+        out << " | text \"" << r.text << "\"";
+    } else if (!r.packet.encryptedData.empty()) {
+        out << " | encrypted " << r.packet.encryptedData.size() << " bytes";
+    }
+    r.summary = out.str();
+}
+
+class DecodePipeline {
+public:
+    // Returns false when the input is exhausted.
+    typedef std::function<bool(std::string&)> Source;
+    typedef std::function<void(const PacketRecord&)> Sink;
+
+    explicit DecodePipeline(const PipelineConfig& cfg) : config(cfg) {}
+
+    PipelineReport run(const Source& source, const Sink& sink) {
+        PipelineReport report;
+        std::vector<SpscQueue<PacketRecord*>*> queues;
+        for (int i = 0; i < HANDOFF_COUNT; i++) {
+            queues.push_back(new SpscQueue<PacketRecord*>(config.queueCapacity));
+        }
+
+        std::vector<LatencyHistogram> latency(HANDOFF_COUNT);
+        uint64_t start = pipelineNowNs();
+
+        std::thread ingest([&] {
+            pin(STAGE_INGEST);
+            StageStats& stats = report.stages[STAGE_INGEST];
+            std::string line;
+            uint64_t sequence = 0;
+            while (source(line)) {
+                if (line.empty()) continue;
+                uint64_t t0 = pipelineNowNs();
+                PacketRecord* record = new PacketRecord();
+                record->sequence = sequence++;
+                record->hexInput.swap(line);
+                if (config.runtime) record->config = config.runtime->pin(record->sequence);
+                handOff(*queues[0], record, 0, t0, stats);
+            }
+            report.ingested = sequence;
+            queues[0]->close();
+        });
+
+        std::thread parse([&] {
+            pin(STAGE_PARSE);
+            runStage(queues, 0, report.stages[STAGE_PARSE], [&](PacketRecord& r) {
+                parseRecord(r);
+            });
+        });
+
+        std::thread decrypt([&] {
+            pin(STAGE_DECRYPT);
+            runStage(queues, 1, report.stages[STAGE_DECRYPT], [&](PacketRecord& r) {
+                if (!r.config) {
+                    decryptRecord(r, config.psk);
+                    return;
+                }
+                const std::vector<uint8_t>& key = r.config->keyFor(r.envelope.channelId);
+                decryptRecord(r, key.empty() ? config.psk : key);
+                // Partly decoded packets are filtered on the fields they have.
+                r.filtered = r.envelope.valid && !r.config->accepts(r.envelope, r.packet, r.data);
+            });
+        });
+
+        std::thread enrich([&] {
+            pin(STAGE_ENRICH);
+            runStage(queues, 2, report.stages[STAGE_ENRICH], [&](PacketRecord& r) {
+                if (r.filtered) return;
+                summarizeRecord(r);
+                if (!r.packet.valid) return;
+                uint32_t time = r.packet.has(MeshPacket::RX_TIME) ? r.packet.rxTime : (uint32_t)std::time(nullptr);
+                if (config.graph) {
+                    config.graph->observeReport(r.envelope, r.packet, time);
+                    if (r.data.valid) config.graph->observeData(r.packet, r.data, time);
+                }
+                if (config.positions && r.data.valid && r.data.portnum == PORT_POSITION) {
+                    Position position = decodeMessage<PositionLayout, Position>(r.data.payload.data(), r.data.payload.size());
+                    if (position.valid) config.positions->update(r.packet.from, position, time);
+                }
+            });
+        });
+
+        std::thread output([&] {
+            pin(STAGE_OUTPUT);
+            StageStats& stats = report.stages[STAGE_OUTPUT];
+            PacketRecord* record = nullptr;
+            while (queues[3]->pop(record)) {
+                uint64_t t0 = pipelineNowNs();
+                record->handoffNs[3] = t0 - record->enqueuedAt[3];
+                if (config.collectLatency) {
+                    for (int i = 0; i < HANDOFF_COUNT; i++) {
+                        latency[i].record(record->handoffNs[i]);
+                    }
+                }
+                if (!record->envelope.valid) report.parseFailures++;
+                if (record->filtered) {
+                    report.filtered++;
+                } else {
+                    sink(*record);
+                    report.delivered++;
+                }
+                if (config.runtime) config.runtime->finished(record->sequence);
+                delete record;
+                stats.processed++;
+                stats.busyNs += pipelineNowNs() - t0;
+            }
+        });
+
+        ingest.join();
+        parse.join();
+        decrypt.join();
+        enrich.join();
+        output.join();
+
+        report.wallNs = pipelineNowNs() - start;
+        for (int i = 0; i < HANDOFF_COUNT; i++) {
+            report.queues[i] = queues[i]->stats();
+            report.handoffs[i] = latency[i].summary();
+            delete queues[i];
+        }
+        return report;
+    }
+
+private:
+    PipelineConfig config;
+
+    void pin(int stage) const {
+        if (config.pinThreads) pinCurrentThread(config.firstCpu + stage);
+    }
+
+    // Pushes `record` into `queue`, honouring the backpressure policy, and
+    // charges the work since `t0` to `stats`.
+    void handOff(SpscQueue<PacketRecord*>& queue, PacketRecord* record, int handoff,
+                 uint64_t t0, StageStats& stats) const {
+        stats.processed++;
+        uint64_t now = pipelineNowNs();
+        stats.busyNs += now - t0;
+        record->enqueuedAt[handoff] = now;
+        if (!queue.push(record, config.policy)) {
+            delete record;
+        }
+    }
+
+    // Runs a middle stage: pops from handoff `inIndex`, applies `work` and
+    // pushes into handoff `inIndex + 1`.
+    template <typename Work>
+    void runStage(std::vector<SpscQueue<PacketRecord*>*>& queues, int inIndex,
+                  StageStats& stats, Work work) const {
+        SpscQueue<PacketRecord*>& in = *queues[inIndex];
+        SpscQueue<PacketRecord*>& out = *queues[inIndex + 1];
+        PacketRecord* record = nullptr;
+        while (in.pop(record)) {
+            uint64_t t0 = pipelineNowNs();
+            record->handoffNs[inIndex] = t0 - record->enqueuedAt[inIndex];
+            work(*record);
+            handOff(out, record, inIndex + 1, t0, stats);
+        }
+        out.close();
+    }
+};
+
+inline void printPipelineReport(std::ostream& out, const PipelineReport& report) {
+    double seconds = report.wallNs / 1e9;
+    out << "\n=== Pipeline Report ===" << std::endl;
+    out << "Ingested: " << report.ingested
+        << ", delivered: " << report.delivered
+        << ", dropped: " << report.dropped()
+        << ", filtered: " << report.filtered
+        << ", parse failures: " << report.parseFailures << std::endl;
+    out << "Wall time: " << std::fixed << std::setprecision(3) << seconds * 1000.0 << " ms ("
+        << std::setprecision(0) << (seconds > 0 ? report.delivered / seconds : 0.0) << " msg/s)" << std::endl;
+
+    out << "\nStage       processed     busy-rate (msg/s)" << std::endl;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        out << std::left << std::setw(12) << stageName(i) << std::right
+            << std::setw(9) << report.stages[i].processed
+            << std::setw(20) << std::setprecision(0) << report.stages[i].itemsPerSecond() << std::endl;
+    }
+
+    out << "\nQueue              cap   max-occ   avg-occ   dropped     parks   p50(ns)   p99(ns)" << std::endl;
+    for (int i = 0; i < HANDOFF_COUNT; i++) {
+        std::string name = std::string(stageName(i)) + "->" + stageName(i + 1);
+        const QueueStats& q = report.queues[i];
+        const HandoffLatency& l = report.handoffs[i];
+        out << std::left << std::setw(16) << name << std::right
+            << std::setw(7) << q.capacity
+            << std::setw(10) << q.maxOccupancy
+            << std::setw(10) << std::setprecision(1) << q.averageOccupancy()
+            << std::setw(10) << q.dropped
+            << std::setw(10) << q.parks
+            << std::setw(10) << l.p50Ns
+            << std::setw(10) << l.p99Ns << std::endl;
+    }
+    out << std::defaultfloat << std::setprecision(6);
+}
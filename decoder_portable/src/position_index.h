@@ -0,0 +1,381 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh_proto.h"
+
+// In-memory spatial index over decoded POSITION packets.
+//
+// Fixes are stored in a uniform lat/lon grid, one grid per time bucket:
+//
+//   buckets (oldest .. newest, bucketSeconds each)
+//     └─ cell key (row, column) -> fixes reported in that cell
+//
+// A query only visits the buckets that overlap its time window and, inside
+// each bucket, only the cells that overlap its area. Expiry drops whole
+// buckets, so retention costs nothing per fix. Results are reduced to one
+// fix per node (the newest for box/radius queries, the closest for
+// nearest()).
+//
+// Coordinates are kept in the protobuf's degrees * 1e7 integers. Distances
+// use the haversine formula; the grid does not wrap at the antimeridian.
+//
+// Fix times are node-supplied, so they are capped at the receive time (and
+// the local clock) plus maxClockSkew before they can drive expiry.
+
+struct PositionIndexConfig {
+    double cellDegrees = 0.05;          // ~5.5 km of latitude
+    uint32_t bucketSeconds = 600;
+    uint32_t retentionSeconds = 24 * 3600;
+    uint32_t maxClockSkew = 600;        // seconds a fix may be ahead of the clock
+};
+
+struct PositionFix {
+    uint32_t node;
+    int32_t latitudeI;
+    int32_t longitudeI;
+    uint32_t time;
+
+    double latitude() const { return latitudeI * 1e-7; }
+    double longitude() const { return longitudeI * 1e-7; }
+};
+
+struct NearbyNode {
+    PositionFix fix;
+    double meters;
+};
+
+static const double PI_DEGREES = 3.14159265358979323846 / 180.0;
+static const double EARTH_RADIUS_METERS = 6371008.8;
+static const double METERS_PER_DEGREE = EARTH_RADIUS_METERS * PI_DEGREES;
+
+inline double haversineMeters(double lat1, double lon1, double lat2, double lon2) {
+    const double earthRadius = EARTH_RADIUS_METERS;
+    const double toRad = PI_DEGREES;
+    double dLat = (lat2 - lat1) * toRad;
+    double dLon = (lon2 - lon1) * toRad;
+    double a = sin(dLat / 2) * sin(dLat / 2) +
+               cos(lat1 * toRad) * cos(lat2 * toRad) * sin(dLon / 2) * sin(dLon / 2);
+    return 2 * earthRadius * asin(std::min(1.0, sqrt(a)));
+}
+
+class PositionIndex {
+public:
+    explicit PositionIndex(const PositionIndexConfig& cfg = PositionIndexConfig())
+        : config(cfg), cellUnits((int64_t)(cfg.cellDegrees * 1e7)) {}
+
+    // Records a fix. Fixes older than the retention window are ignored;
+    // starting a new bucket expires the ones that fell out of the window.
+    void update(uint32_t node, int32_t latitudeI, int32_t longitudeI, uint32_t time) {
+        if (latitudeI == 0 && longitudeI == 0) return;  // no fix
+        uint64_t latest = (uint64_t)std::time(nullptr) + config.maxClockSkew;
+        if (time > latest) time = (uint32_t)latest;
+        std::unique_lock<std::shared_mutex> lock(mutex);
+
+        if (time > newestTime) newestTime = time;
+        expireLocked(newestTime);
+        uint32_t start = time - time % config.bucketSeconds;
+        if (newestTime - start >= config.retentionSeconds + config.bucketSeconds) return;
+
+        TimeBucket* bucket = findBucket(start);
+        if (!bucket) bucket = insertBucket(start);
+        int64_t r = row(latitudeI);
+        int64_t c = column(longitudeI);
+        bucket->minRow = std::min(bucket->minRow, r);
+        bucket->maxRow = std::max(bucket->maxRow, r);
+        bucket->minColumn = std::min(bucket->minColumn, c);
+        bucket->maxColumn = std::max(bucket->maxColumn, c);
+        bucket->cells[cellKey(r, c)].push_back(
+            PositionFix{node, latitudeI, longitudeI, time});
+        bucket->fixes++;
+        fixCount++;
+    }
+
+    // Convenience for a decoded POSITION_APP payload.
+    bool update(uint32_t node, const Position& position, uint32_t receivedAt) {
+        if (!position.has(Position::LATITUDE_I) || !position.has(Position::LONGITUDE_I)) return false;
+        uint32_t time = position.time ? position.time : receivedAt;
+        if ((uint64_t)time > (uint64_t)receivedAt + config.maxClockSkew) time = receivedAt;
+        update(node, position.latitudeI, position.longitudeI, time);
+        return true;
+    }
+
+    // Drops every bucket that ended before now - retentionSeconds.
+    void expire(uint32_t now) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        expireLocked(now);
+    }
+
+    // Nodes with a fix inside the box since `since`; newest fix per node.
+    std::vector<PositionFix> queryBox(double minLat, double minLon, double maxLat, double maxLon,
+                                      uint32_t since) const {
+        std::vector<PositionFix> hits;
+        int32_t latLo = fixedLatitude(minLat), latHi = fixedLatitude(maxLat);
+        int32_t lonLo = fixedLongitude(minLon), lonHi = fixedLongitude(maxLon);
+
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        scanCells(row(latLo), row(latHi), column(lonLo), column(lonHi), since, [&](const PositionFix& f) {
+            if (f.latitudeI >= latLo && f.latitudeI <= latHi && f.longitudeI >= lonLo && f.longitudeI <= lonHi) {
+                hits.push_back(f);
+            }
+        });
+        return newestPerNode(hits);
+    }
+
+    // Nodes with a fix within `meters` of the point since `since`.
+    std::vector<NearbyNode> queryRadius(double lat, double lon, double meters, uint32_t since) const {
+        lat = std::clamp(lat, -90.0, 90.0);
+        lon = std::clamp(lon, -180.0, 180.0);
+        double angle = meters / EARTH_RADIUS_METERS;    // radians
+        double dLat = angle / PI_DEGREES;
+        // A circle around a pole covers every longitude; otherwise its
+        // widest point is asin(sin(angle) / cos(lat)) either side.
+        double dLon = 180.0;
+        if (lat - dLat > -90.0 && lat + dLat < 90.0) {
+            dLon = asin(std::min(1.0, sin(angle) / cos(lat * PI_DEGREES))) / PI_DEGREES;
+        }
+        int64_t rowLo = row(fixedLatitude(lat - dLat)), rowHi = row(fixedLatitude(lat + dLat));
+
+        std::vector<NearbyNode> hits;
+        auto visit = [&](const PositionFix& f) {
+            double d = haversineMeters(lat, lon, f.latitude(), f.longitude());
+            if (d <= meters) hits.push_back(NearbyNode{f, d});
+        };
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        if (dLon >= 180.0) {
+            scanCells(rowLo, rowHi, column(fixedLongitude(-180.0)), column(fixedLongitude(180.0)), since, visit);
+        } else {
+            // Past the antimeridian the circle continues from the other side.
+            scanCells(rowLo, rowHi, column(fixedLongitude(lon - dLon)), column(fixedLongitude(lon + dLon)),
+                      since, visit);
+            if (lon - dLon < -180.0) {
+                scanCells(rowLo, rowHi, column(fixedLongitude(lon - dLon + 360.0)),
+                          column(fixedLongitude(180.0)), since, visit);
+            }
+            if (lon + dLon > 180.0) {
+                scanCells(rowLo, rowHi, column(fixedLongitude(-180.0)),
+                          column(fixedLongitude(lon + dLon - 360.0)), since, visit);
+            }
+        }
+        lock.unlock();
+
+        std::vector<PositionFix> fixes;
+        fixes.reserve(hits.size());
+        for (const NearbyNode& h : hits) fixes.push_back(h.fix);
+        fixes = newestPerNode(fixes);
+
+        std::vector<NearbyNode> result;
+        result.reserve(fixes.size());
+        for (const PositionFix& f : fixes) {
+            result.push_back(NearbyNode{f, haversineMeters(lat, lon, f.latitude(), f.longitude())});
+        }
+        return result;
+    }
+
+    // The `k` nodes closest to the point, by their closest fix since `since`.
+    // Searches rings of cells outwards and stops once no unvisited cell can
+    // hold anything closer than the current k-th candidate, every fix in the
+    // time window has been seen, or the rings cover every occupied cell.
+    std::vector<NearbyNode> nearest(double lat, double lon, size_t k, uint32_t since) const {
+        std::vector<NearbyNode> candidates;
+        if (k == 0) return candidates;
+        int64_t centerRow = row(fixedLatitude(lat));
+        int64_t centerColumn = column(fixedLongitude(lon));
+        double cellMetersLat = config.cellDegrees * METERS_PER_DEGREE;
+        double cellMetersLon = cellMetersLat * std::max(0.01, cos(lat * PI_DEGREES));
+        double ringMeters = std::min(cellMetersLat, cellMetersLon);
+
+        std::unordered_map<uint32_t, size_t> slotOf;  // node -> index in candidates
+        size_t visited = 0;
+        auto consider = [&](const PositionFix& f) {
+            visited++;
+            double d = haversineMeters(lat, lon, f.latitude(), f.longitude());
+            auto it = slotOf.find(f.node);
+            if (it == slotOf.end()) {
+                slotOf.emplace(f.node, candidates.size());
+                candidates.push_back(NearbyNode{f, d});
+            } else if (d < candidates[it->second].meters) {
+                candidates[it->second] = NearbyNode{f, d};
+            }
+        };
+
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        int64_t minRow = INT64_MAX, maxRow = INT64_MIN;
+        int64_t minColumn = INT64_MAX, maxColumn = INT64_MIN;
+        size_t inWindow = 0;
+        for (auto it = buckets.rbegin(); it != buckets.rend(); ++it) {
+            if (it->start + config.bucketSeconds <= since) break;
+            minRow = std::min(minRow, it->minRow);
+            maxRow = std::max(maxRow, it->maxRow);
+            minColumn = std::min(minColumn, it->minColumn);
+            maxColumn = std::max(maxColumn, it->maxColumn);
+            if (it->start >= since) {
+                inWindow += it->fixes;
+            } else {
+                for (const auto& cell : it->cells) {
+                    for (const PositionFix& f : cell.second) inWindow += f.time >= since;
+                }
+            }
+        }
+        if (inWindow == 0) return candidates;
+        for (int64_t ring = 0;; ring++) {
+            if (ring == 0) {
+                visitCell(centerRow, centerColumn, since, consider);
+            } else {
+                for (int64_t c = centerColumn - ring; c <= centerColumn + ring; c++) {
+                    visitCell(centerRow - ring, c, since, consider);
+                    visitCell(centerRow + ring, c, since, consider);
+                }
+                for (int64_t r = centerRow - ring + 1; r <= centerRow + ring - 1; r++) {
+                    visitCell(r, centerColumn - ring, since, consider);
+                    visitCell(r, centerColumn + ring, since, consider);
+                }
+            }
+            if (candidates.size() >= k) {
+                std::nth_element(candidates.begin(), candidates.begin() + (k - 1), candidates.end(),
+                                 [](const NearbyNode& a, const NearbyNode& b) { return a.meters < b.meters; });
+                // Everything outside the searched square is at least `ring`
+                // whole cells away from the centre cell.
+                if (candidates[k - 1].meters <= ring * ringMeters) break;
+                for (size_t i = 0; i < candidates.size(); i++) slotOf[candidates[i].fix.node] = i;
+            }
+            if (visited == inWindow) break;
+            // Stop once the square covers every cell filled in the window.
+            if (centerRow - ring <= minRow && centerRow + ring >= maxRow &&
+                centerColumn - ring <= minColumn && centerColumn + ring >= maxColumn) {
+                break;
+            }
+        }
+        lock.unlock();
+
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const NearbyNode& a, const NearbyNode& b) { return a.meters < b.meters; });
+        if (candidates.size() > k) candidates.resize(k);
+        return candidates;
+    }
+
+    size_t size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return fixCount;
+    }
+
+    size_t bucketCount() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return buckets.size();
+    }
+
+private:
+    struct TimeBucket {
+        uint32_t start;
+        size_t fixes = 0;
+        int64_t minRow = INT64_MAX, maxRow = INT64_MIN;         // occupied cell bounds
+        int64_t minColumn = INT64_MAX, maxColumn = INT64_MIN;
+        std::unordered_map<uint64_t, std::vector<PositionFix>> cells;
+    };
+
+    PositionIndexConfig config;
+    int64_t cellUnits;
+
+    mutable std::shared_mutex mutex;
+    std::deque<TimeBucket> buckets;     // ordered by start
+    uint32_t newestTime = 0;
+    size_t fixCount = 0;
+
+    // Query coordinates in 1e-7 degrees, clamped to the valid range so the
+    // conversion cannot overflow int32.
+    static int32_t fixedLatitude(double degrees) { return (int32_t)std::lround(std::clamp(degrees, -90.0, 90.0) * 1e7); }
+    static int32_t fixedLongitude(double degrees) { return (int32_t)std::lround(std::clamp(degrees, -180.0, 180.0) * 1e7); }
+
+    int64_t row(int32_t latitudeI) const { return ((int64_t)latitudeI + 900000000) / cellUnits; }
+    int64_t column(int32_t longitudeI) const { return ((int64_t)longitudeI + 1800000000) / cellUnits; }
+
+    static uint64_t cellKey(int64_t r, int64_t c) { return ((uint64_t)(uint32_t)r << 32) | (uint32_t)c; }
+
+    TimeBucket* findBucket(uint32_t start) {
+        for (auto it = buckets.rbegin(); it != buckets.rend(); ++it) {
+            if (it->start == start) return &*it;
+            if (it->start < start) break;
+        }
+        return nullptr;
+    }
+
+    TimeBucket* insertBucket(uint32_t start) {
+        auto it = std::upper_bound(buckets.begin(), buckets.end(), start,
+                                   [](uint32_t s, const TimeBucket& b) { return s < b.start; });
+        it = buckets.insert(it, TimeBucket());
+        it->start = start;
+        return &*it;
+    }
+
+    void expireLocked(uint32_t now) {
+        while (!buckets.empty() &&
+               buckets.front().start + config.bucketSeconds + config.retentionSeconds <= now) {
+            fixCount -= buckets.front().fixes;
+            buckets.pop_front();
+        }
+    }
+
+    template <typename Visit>
+    void visitCell(int64_t r, int64_t c, uint32_t since, Visit visit) const {
+        uint64_t key = cellKey(r, c);
+        for (auto it = buckets.rbegin(); it != buckets.rend(); ++it) {
+            if (it->start + config.bucketSeconds <= since) break;
+            auto cell = it->cells.find(key);
+            if (cell == it->cells.end()) continue;
+            for (const PositionFix& f : cell->second) {
+                if (f.time >= since) visit(f);
+            }
+        }
+    }
+
+    // Visits every fix in the cell rectangle. When the rectangle has more
+    // cells than a bucket, that bucket's occupied cells are walked instead.
+    template <typename Visit>
+    void scanCells(int64_t rowLo, int64_t rowHi, int64_t colLo, int64_t colHi, uint32_t since, Visit visit) const {
+        uint64_t area = (uint64_t)(rowHi - rowLo + 1) * (uint64_t)(colHi - colLo + 1);
+        for (auto it = buckets.rbegin(); it != buckets.rend(); ++it) {
+            if (it->start + config.bucketSeconds <= since) break;
+            if (area > it->cells.size()) {
+                for (const auto& cell : it->cells) {
+                    int64_t r = (int64_t)(cell.first >> 32);
+                    int64_t c = (int64_t)(uint32_t)cell.first;
+                    if (r < rowLo || r > rowHi || c < colLo || c > colHi) continue;
+                    for (const PositionFix& f : cell.second) {
+                        if (f.time >= since) visit(f);
+                    }
+                }
+                continue;
+            }
+            for (int64_t r = rowLo; r <= rowHi; r++) {
+                for (int64_t c = colLo; c <= colHi; c++) {
+                    auto cell = it->cells.find(cellKey(r, c));
+                    if (cell == it->cells.end()) continue;
+                    for (const PositionFix& f : cell->second) {
+                        if (f.time >= since) visit(f);
+                    }
+                }
+            }
+        }
+    }
+
+    static std::vector<PositionFix> newestPerNode(std::vector<PositionFix>& fixes) {
+        std::sort(fixes.begin(), fixes.end(), [](const PositionFix& a, const PositionFix& b) {
+            if (a.node != b.node) return a.node < b.node;
+            return a.time > b.time;
+        });
+        std::vector<PositionFix> result;
+        for (const PositionFix& f : fixes) {
+            if (result.empty() || result.back().node != f.node) result.push_back(f);
+        }
+        return result;
+    }
+};
@@ -0,0 +1,458 @@
+#pragma once
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "mesh_decoder.h"
+#include "mesh_graph.h"
+
+// Keyrings and filter rules for the service mode, reloadable while traffic
+// is flowing.
+//
+// Config file, one directive per line ('#' starts a comment):
+//
+//   key <channel> <AQ==|hex>       PSK for packets on that channel id
+//   key * <AQ==|hex>               PSK for every other channel
+//   allow|drop from <!node>        filter rules, first match wins
+//   allow|drop to <!node>
+//   allow|drop channel <name>
+//   allow|drop gateway <!node>
+//   allow|drop port <number>
+//   default allow|drop             when no rule matches (default: allow)
+//
+// A packet whose tail failed to decode is still filtered on the fields it
+// has. If a rule needs a field it lacks (from, to or port), the packet is
+// dropped, because the missing field could have matched a drop rule.
+//
+// Channels without a key fall back to the key given with --psk. A port rule
+// matches plaintext packets and encrypted ones that decrypt to readable
+// text (port 1, TEXT_MESSAGE); other ciphertext has no known port and never
+// matches a port rule.
+//
+// Configs are immutable once published. ConfigHandle publishes a new one by
+// swapping a pointer (read-copy-update): the ingest stage pins the current
+// config onto each record without taking a lock, and a replaced config is
+// freed only after every record pinned to it has left the pipeline. Records
+// already in flight during a reload therefore finish with the old keys and
+// rules, and none are dropped or stalled by it.
+
+enum class FilterAction { Allow, Drop };
+
+enum class FilterField { From, To, Channel, Gateway, Port };
+
+struct FilterRule {
+    FilterAction action = FilterAction::Allow;
+    FilterField field = FilterField::From;
+    uint32_t number = 0;        // node id or port
+    std::string text;           // channel id
+
+    bool matches(const ServiceEnvelope& envelope, const MeshPacket& packet, const DataMessage& data) const {
+        switch (field) {
+        case FilterField::From:
+            return packet.has(MeshPacket::FROM) && packet.from == number;
+        case FilterField::To:
+            return packet.has(MeshPacket::TO) && packet.to == number;
+        case FilterField::Channel:
+            return envelope.channelId == text;
+        case FilterField::Gateway: {
+            uint32_t gateway = 0;
+            return parseNodeId(envelope.gatewayId, gateway) && gateway == number;
+        }
+        case FilterField::Port:
+            return data.valid && (uint32_t)data.portnum == number;
+        }
+        return false;
+    }
+
+    // A malformed packet may have lost the field this rule looks at in the
+    // tail that failed to decode, so whether the rule matches is unknown.
+    bool decidable(const MeshPacket& packet, const DataMessage& data) const {
+        if (packet.valid) return true;
+        switch (field) {
+        case FilterField::From:
+            return packet.has(MeshPacket::FROM);
+        case FilterField::To:
+            return packet.has(MeshPacket::TO);
+        case FilterField::Port:
+            return data.valid;
+        default:
+            return true;
+        }
+    }
+};
+
+struct DecoderConfig {
+    uint64_t version = 0;                   // assigned by ConfigHandle::publish
+    std::vector<uint8_t> defaultKey;
+    std::unordered_map<std::string, std::vector<uint8_t>> channelKeys;
+    std::vector<FilterRule> rules;
+    FilterAction defaultAction = FilterAction::Allow;
+
+    const std::vector<uint8_t>& keyFor(const std::string& channel) const {
+        auto it = channelKeys.find(channel);
+        return it != channelKeys.end() ? it->second : defaultKey;
+    }
+
+    // Applies the rules to whatever fields decoded. A packet that reaches a
+    // rule it cannot be checked against is dropped rather than let through.
+    bool accepts(const ServiceEnvelope& envelope, const MeshPacket& packet, const DataMessage& data) const {
+        for (const FilterRule& rule : rules) {
+            if (!rule.decidable(packet, data)) return false;
+            if (rule.matches(envelope, packet, data)) return rule.action == FilterAction::Allow;
+        }
+        return defaultAction == FilterAction::Allow;
+    }
+};
+
+inline bool parseKey(const std::string& text, std::vector<uint8_t>& key) {
+    if (text != "AQ==") {
+        if (text.size() != 32 && text.size() != 64) return false;
+        for (char c : text) {
+            if (!isxdigit((unsigned char)c)) return false;
+        }
+    }
+    key = getPSKFromInput(text, false);
+    return true;
+}
+
+inline bool parseDecoderConfig(std::istream& in, DecoderConfig& config, std::string& error) {
+    std::string line;
+    int number = 0;
+    while (std::getline(in, line)) {
+        number++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        std::istringstream words(line);
+        std::string directive, first, second, extra;
+        if (!(words >> directive)) continue;
+        words >> first >> second >> extra;
+
+        std::string where = "line " + std::to_string(number) + ": ";
+        if (directive == "key") {
+            std::vector<uint8_t> key;
+            if (first.empty() || !extra.empty() || !parseKey(second, key)) {
+                error = where + "expected: key <channel|*> <AQ==|32 or 64 hex digits>";
+                return false;
+            }
+            if (first == "*") {
+                config.defaultKey = key;
+            } else {
+                config.channelKeys[first] = key;
+            }
+        } else if (directive == "default") {
+            if (first != "allow" && first != "drop") {
+                error = where + "expected: default allow|drop";
+                return false;
+            }
+            config.defaultAction = first == "allow" ? FilterAction::Allow : FilterAction::Drop;
+        } else if (directive == "allow" || directive == "drop") {
+            FilterRule rule;
+            rule.action = directive == "allow" ? FilterAction::Allow : FilterAction::Drop;
+            bool ok = !second.empty() && extra.empty();
+            if (first == "from" || first == "to" || first == "gateway") {
+                rule.field = first == "from" ? FilterField::From
+                           : first == "to" ? FilterField::To : FilterField::Gateway;
+                ok = ok && parseNodeId(second, rule.number);
+            } else if (first == "channel") {
+                rule.field = FilterField::Channel;
+                rule.text = second;
+            } else if (first == "port") {
+                rule.field = FilterField::Port;
+                char* end = nullptr;
+                rule.number = (uint32_t)strtoul(second.c_str(), &end, 10);
+                ok = ok && end != second.c_str() && *end == '\0';
+            } else {
+                ok = false;
+            }
+            if (!ok) {
+                error = where + "expected: " + directive + " from|to|gateway <!node>, channel <name> or port <number>";
+                return false;
+            }
+            config.rules.push_back(rule);
+        } else {
+            error = where + "unknown directive '" + directive + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool loadDecoderConfig(const std::string& path, DecoderConfig& config, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "cannot open config file " + path;
+        return false;
+    }
+    return parseDecoderConfig(in, config, error);
+}
+
+// Publication point for DecoderConfig versions.
+//
+// Reader side: a single thread (the ingest stage) calls pin() for each
+// record, and the last stage calls finished() once a record is done. Both
+// are a few atomic operations; neither blocks.
+//
+// Writer side: publish() swaps the pointer, waits for the pinning thread to
+// leave any pin() in progress (the grace period), and retires the old
+// config together with the number of records pinned so far. reclaim()
+// frees retired configs once that many records have finished.
+class ConfigHandle {
+public:
+    explicit ConfigHandle(std::unique_ptr<DecoderConfig> initial) {
+        initial->version = 1;
+        current.store(initial.release());
+    }
+
+    ~ConfigHandle() {
+        delete current.load();
+        for (Retired& old : retired) delete old.config;
+    }
+
+    ConfigHandle(const ConfigHandle&) = delete;
+    ConfigHandle& operator=(const ConfigHandle&) = delete;
+
+    // Returns the config for record `sequence`; it stays valid until
+    // finished() has been called for that record.
+    const DecoderConfig* pin(uint64_t sequence) {
+        uint64_t state = readerState.load(std::memory_order_relaxed);
+        readerState.store(state + 1);       // odd: inside pin()
+        const DecoderConfig* config = current.load();
+        pinnedCount.store(sequence + 1, std::memory_order_release);
+        readerState.store(state + 2, std::memory_order_release);
+        return config;
+    }
+
+    // Records reach the last stage in sequence order (or are dropped on the
+    // way), so one counter covers every record up to `sequence`.
+    void finished(uint64_t sequence) {
+        finishedCount.store(sequence + 1, std::memory_order_release);
+    }
+
+    // Installs `next` and returns its version. Writers are serialised.
+    uint64_t publish(std::unique_ptr<DecoderConfig> next) {
+        std::lock_guard<std::mutex> lock(writer);
+        next->version = ++latestVersion;
+        uint64_t version = next->version;
+        DecoderConfig* old = current.exchange(next.release());
+        publishedVersion.store(version, std::memory_order_release);
+
+        // Grace period: a pin() that may have read `old` must complete
+        // before the pinned count is meaningful.
+        uint64_t state = readerState.load();
+        if (state & 1) {
+            while (readerState.load() == state) std::this_thread::yield();
+        }
+        retired.push_back({old, pinnedCount.load(std::memory_order_acquire)});
+        reclaimLocked();
+        return version;
+    }
+
+    // Frees retired configs that no record can still be using.
+    void reclaim() {
+        std::lock_guard<std::mutex> lock(writer);
+        reclaimLocked();
+    }
+
+    // Kept apart from the config itself, which reclaim() may free while
+    // this is read.
+    uint64_t version() const { return publishedVersion.load(std::memory_order_acquire); }
+
+    size_t retiredCount() {
+        std::lock_guard<std::mutex> lock(writer);
+        return retired.size();
+    }
+
+private:
+    struct Retired {
+        DecoderConfig* config;
+        uint64_t pinnedBefore;      // records [0, pinnedBefore) may use it
+    };
+
+    std::atomic<DecoderConfig*> current{nullptr};
+    std::atomic<uint64_t> readerState{0};
+    std::atomic<uint64_t> pinnedCount{0};
+    std::atomic<uint64_t> finishedCount{0};
+    std::atomic<uint64_t> publishedVersion{1};
+
+    std::mutex writer;
+    uint64_t latestVersion = 1;
+    std::vector<Retired> retired;
+
+    void reclaimLocked() {
+        uint64_t done = finishedCount.load(std::memory_order_acquire);
+        size_t kept = 0;
+        for (Retired& old : retired) {
+            if (old.pinnedBefore <= done) {
+                delete old.config;
+            } else {
+                retired[kept++] = old;
+            }
+        }
+        retired.resize(kept);
+    }
+};
+
+struct ReloadStats {
+    uint64_t reloads = 0;
+    uint64_t failures = 0;
+    uint64_t lastLatencyNs = 0;     // change noticed -> new config published
+    uint64_t maxLatencyNs = 0;
+    uint64_t totalLatencyNs = 0;
+    std::string lastError;
+
+    double averageLatencyMs() const {
+        return reloads ? totalLatencyNs / 1e6 / (double)reloads : 0.0;
+    }
+};
+
+// Reloads the config file when it changes and publishes it through a
+// ConfigHandle. On Linux the file's directory is watched with inotify, so
+// both in-place edits and atomic renames are seen; elsewhere the file's
+// modification time is polled. A file that fails to parse is reported and
+// the previous config stays in force.
+class ConfigWatcher {
+public:
+    ConfigWatcher(const std::string& configPath, ConfigHandle& configHandle)
+        : path(configPath), handle(configHandle) {}
+
+    ~ConfigWatcher() { stop(); }
+
+    bool start(std::string& error) {
+        std::filesystem::path file(path);
+        fileName = file.filename().string();
+#ifdef __linux__
+        notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        std::string dir = file.has_parent_path() ? file.parent_path().string() : ".";
+        if (notifyFd < 0 || inotify_add_watch(notifyFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            error = "cannot watch " + dir + " for changes";
+            closeNotify();
+            return false;
+        }
+#else
+        std::error_code ec;
+        lastWrite = std::filesystem::last_write_time(file, ec);
+#endif
+        running = true;
+        try {
+            worker = std::thread([this] { run(); });
+        } catch (const std::system_error& e) {
+            running = false;
+            error = std::string("cannot start the config watcher thread: ") + e.what();
+            closeNotify();
+            return false;
+        }
+        return true;
+    }
+
+    void stop() {
+        if (!running.exchange(false)) return;
+        worker.join();
+        closeNotify();
+    }
+
+    // Loads the file and publishes it; used by the watcher and on demand.
+    bool reload() {
+        uint64_t start = nowNs();
+        std::unique_ptr<DecoderConfig> next(new DecoderConfig());
+        std::string error;
+        bool ok = loadDecoderConfig(path, *next, error);
+        if (ok) handle.publish(std::move(next));
+        uint64_t latency = nowNs() - start;
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        if (ok) {
+            reloadStats.reloads++;
+            reloadStats.lastLatencyNs = latency;
+            reloadStats.totalLatencyNs += latency;
+            reloadStats.maxLatencyNs = std::max(reloadStats.maxLatencyNs, latency);
+        } else {
+            reloadStats.failures++;
+            reloadStats.lastError = error;
+            std::cerr << "WARNING: config reload failed, keeping version " << handle.version()
+                      << ": " << error << std::endl;
+        }
+        return ok;
+    }
+
+    ReloadStats stats() {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        return reloadStats;
+    }
+
+private:
+    std::string path;
+    std::string fileName;
+    ConfigHandle& handle;
+    std::atomic<bool> running{false};
+    std::thread worker;
+    std::mutex statsMutex;
+    ReloadStats reloadStats;
+#ifdef __linux__
+    int notifyFd = -1;
+#else
+    std::filesystem::file_time_type lastWrite;
+#endif
+
+    static uint64_t nowNs() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void closeNotify() {
+#ifdef __linux__
+        if (notifyFd >= 0) close(notifyFd);
+        notifyFd = -1;
+#endif
+    }
+
+    void run() {
+        while (running) {
+            if (changed()) reload();
+            handle.reclaim();
+        }
+    }
+
+    // Waits up to 50 ms for a change to the config file.
+    bool changed() {
+#ifdef __linux__
+        pollfd waitFor = {notifyFd, POLLIN, 0};
+        if (poll(&waitFor, 1, 50) <= 0) return false;
+        alignas(inotify_event) char buffer[4096];
+        bool hit = false;
+        ssize_t length;
+        while ((length = read(notifyFd, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + length;) {
+                inotify_event* event = (inotify_event*)p;
+                if (event->len && fileName == event->name) hit = true;
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        return hit;
+#else
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        std::error_code ec;
+        auto stamp = std::filesystem::last_write_time(path, ec);
+        if (ec || stamp == lastWrite) return false;
+        lastWrite = stamp;
+        return true;
+#endif
+    }
+};
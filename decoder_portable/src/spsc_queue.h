@@ -0,0 +1,236 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Bounded single-producer/single-consumer ring buffer.
+//
+// Exactly one thread may call push()/tryPush() and exactly one other thread
+// may call pop()/tryPop(). Head and tail live on separate cache lines and
+// each side keeps a cached copy of the other side's index, so the common
+// case touches no shared cache line at all.
+//
+// A side that has to wait spins briefly, then parks on a condition variable
+// until the other side makes progress or the queue is closed, so idle
+// stages of a long-running pipeline do not burn CPU.
+
+enum class Backpressure {
+    Block,  // producer waits for a free slot
+    Drop    // producer discards the item and counts it
+};
+
+struct QueueStats {
+    uint64_t pushed = 0;
+    uint64_t popped = 0;
+    uint64_t dropped = 0;
+    uint64_t blockedSpins = 0;   // producer retries while the queue was full
+    uint64_t parks = 0;          // times either side went to sleep
+    uint64_t occupancySum = 0;   // sampled every few pushes, for the average
+    uint64_t occupancySamples = 0;
+    size_t maxOccupancy = 0;
+    size_t capacity = 0;
+
+    double averageOccupancy() const {
+        return occupancySamples ? (double)occupancySum / (double)occupancySamples : 0.0;
+    }
+};
+
+template <typename T>
+class SpscQueue {
+private:
+    static constexpr size_t kCacheLine = 64;
+    static constexpr unsigned kBusySpins = 64;      // then yield
+    static constexpr unsigned kSpinLimit = 256;     // then park
+    static constexpr uint64_t kOccupancySampleEvery = 16;
+
+    std::vector<T> slots;
+    size_t mask;
+
+    alignas(kCacheLine) std::atomic<size_t> head{0};  // next slot to pop
+    size_t cachedTail = 0;                            // consumer's view of tail
+    uint64_t poppedCount = 0;
+
+    alignas(kCacheLine) std::atomic<size_t> tail{0};  // next slot to push
+    size_t cachedHead = 0;                            // producer's view of head
+    uint64_t pushedCount = 0;
+    uint64_t droppedCount = 0;
+    uint64_t spinCount = 0;
+    uint64_t occupancySum = 0;
+    uint64_t occupancySamples = 0;
+    size_t maxOccupancy = 0;
+
+    alignas(kCacheLine) std::atomic<bool> closed{false};
+    std::atomic<bool> consumerParked{false};
+    std::atomic<bool> producerParked{false};
+    std::mutex parkMutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    uint64_t producerParks = 0;
+    uint64_t consumerParks = 0;
+
+    // Called after publishing progress: wakes the other side if it parked.
+    // The fence pairs with the one in park(), so either the parked side sees
+    // the new index on its re-check or this side sees the parked flag.
+    void wake(std::atomic<bool>& parked, std::condition_variable& cv) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(parkMutex);
+            cv.notify_one();
+        }
+    }
+
+    // Sleeps until `ready()` or the queue is closed; returns ready().
+    template <typename Ready>
+    bool park(std::atomic<bool>& parked, std::condition_variable& cv, Ready ready) {
+        std::unique_lock<std::mutex> lock(parkMutex);
+        parked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool ok;
+        while (!(ok = ready()) && !closed.load(std::memory_order_acquire)) {
+            cv.wait(lock);
+        }
+        parked.store(false, std::memory_order_relaxed);
+        return ok;
+    }
+
+    static size_t roundUpPow2(size_t n) {
+        size_t p = 2;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    // Ring operations without waking the other side; park() calls them
+    // with parkMutex held.
+    bool pushSlot(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead >= slots.size()) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead >= slots.size()) {
+                return false;
+            }
+        }
+        slots[t & mask] = item;
+        tail.store(t + 1, std::memory_order_release);
+
+        // cachedHead is only refreshed when the ring looks full, so the
+        // occupancy is sampled against a fresh head instead.
+        if (pushedCount++ % kOccupancySampleEvery == 0) {
+            size_t occupancy = t + 1 - head.load(std::memory_order_acquire);
+            occupancySum += occupancy;
+            occupancySamples++;
+            if (occupancy > maxOccupancy) maxOccupancy = occupancy;
+        }
+        return true;
+    }
+
+    bool popSlot(T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail) {
+                return false;
+            }
+        }
+        item = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        poppedCount++;
+        return true;
+    }
+
+public:
+    explicit SpscQueue(size_t capacity) : slots(roundUpPow2(capacity)), mask(slots.size() - 1) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    size_t capacity() const { return slots.size(); }
+
+    // Approximate occupancy; exact only when called from one of the two ends.
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    bool tryPush(const T& item) {
+        if (!pushSlot(item)) return false;
+        wake(consumerParked, notEmpty);
+        return true;
+    }
+
+    // Returns false when the item was dropped (Drop policy) or the queue was
+    // closed while waiting (Block policy).
+    bool push(const T& item, Backpressure policy) {
+        if (tryPush(item)) return true;
+        if (policy == Backpressure::Drop) {
+            droppedCount++;
+            return false;
+        }
+        unsigned spins = 0;
+        while (!tryPush(item)) {
+            if (closed.load(std::memory_order_acquire)) return false;
+            spinCount++;
+            if (++spins > kSpinLimit) {
+                producerParks++;
+                if (!park(producerParked, notFull, [&] { return pushSlot(item); })) return false;
+                wake(consumerParked, notEmpty);
+                return true;
+            }
+            if (spins > kBusySpins) std::this_thread::yield();
+        }
+        return true;
+    }
+
+    bool tryPop(T& item) {
+        if (!popSlot(item)) return false;
+        wake(producerParked, notFull);
+        return true;
+    }
+
+    // Blocks until an item is available. Returns false once the queue has
+    // been closed and fully drained.
+    bool pop(T& item) {
+        unsigned spins = 0;
+        while (!tryPop(item)) {
+            if (closed.load(std::memory_order_acquire)) {
+                return tryPop(item);
+            }
+            if (++spins > kSpinLimit) {
+                consumerParks++;
+                if (!park(consumerParked, notEmpty, [&] { return popSlot(item); })) {
+                    return tryPop(item);    // closed: drain what is left
+                }
+                wake(producerParked, notFull);
+                return true;
+            }
+            if (spins > kBusySpins) std::this_thread::yield();
+        }
+        return true;
+    }
+
+    // Called by the producer after its last push.
+    void close() {
+        closed.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(parkMutex);
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+    // Only meaningful once both ends have stopped.
+    QueueStats stats() const {
+        QueueStats s;
+        s.pushed = pushedCount;
+        s.popped = poppedCount;
+        s.dropped = droppedCount;
+        s.blockedSpins = spinCount;
+        s.parks = producerParks + consumerParks;
+        s.occupancySum = occupancySum;
+        s.occupancySamples = occupancySamples;
+        s.maxOccupancy = maxOccupancy;
+        s.capacity = slots.size();
+        return s;
+    }
+};
@@ -5,230 +5,65 @@
 #include <algorithm>
 #include <sstream>
 
-using namespace std;
-
-// 将十六进制字符串转换为字节数组
-vector<uint8_t> hexToBytes(string hex) {
-    vector<uint8_t> bytes;
-    // 移除所有空格、换行等空白字符
-    hex.erase(remove_if(hex.begin(), hex.end(), ::isspace), hex.end());
-    
-    for (size_t i = 0; i < hex.length(); i += 2) {
-        if (i + 1 < hex.length()) {
-            string byteStr = hex.substr(i, 2);
-            bytes.push_back((uint8_t)strtol(byteStr.c_str(), nullptr, 16));
-        }
-    }
-    return bytes;
-}
-
-// 打印字节数组
-void printHex(const vector<uint8_t>& data, const string& label = "") {
-    if (!label.empty()) {
-        cout << label << ": ";
-    }
-    for (size_t i = 0; i < data.size(); i++) {
-        cout << hex << setw(2) << setfill('0') << (int)data[i];
-        if (i < data.size() - 1) cout << " ";
-    }
-    cout << dec << endl;
-}
-
-// 解析varint
-uint64_t decodeVarint(const uint8_t*& data, size_t& remaining) {
-    uint64_t result = 0;
-    int shift = 0;
-    
-    while (remaining > 0 && shift < 64) {
-        uint8_t byte = *data++;
-        remaining--;
-        
-        result |= ((uint64_t)(byte & 0x7F)) << shift;
-        
-        if ((byte & 0x80) == 0) {
-            break;
-        }
-        shift += 7;
-    }
-    
-    return result;
-}
-
-// ServiceEnvelope结构
-struct ServiceEnvelope {
-    vector<uint8_t> packetData;
-    string channelId;
-    string gatewayId;
-    bool valid = false;
-};
+#include "../decoder_portable/src/mesh_proto.h"
 
-// MeshPacket结构
-struct MeshPacket {
-    uint32_t from = 0;
-    uint32_t to = 0;
-    uint64_t id = 0;
-    uint32_t channel = 0;
-    uint32_t hopLimit = 0;
-    uint32_t hopStart = 0;
-    bool wantAck = false;
-    vector<uint8_t> encryptedData;
-    bool valid = false;
-};
+using namespace std;
 
-// 解析ServiceEnvelope
+// 解析ServiceEnvelope (使用共享的schema解析器, 然后打印各字段)
 ServiceEnvelope parseServiceEnvelope(const uint8_t* data, size_t length) {
-    ServiceEnvelope envelope;
-    const uint8_t* ptr = data;
-    size_t remaining = length;
+    ServiceEnvelope envelope = decodeServiceEnvelope(data, length);
     
     cout << "\n=== ServiceEnvelope解析 ===" << endl;
-    
-    while (remaining > 0) {
-        uint64_t fieldInfo = decodeVarint(ptr, remaining);
-        int fieldNumber = fieldInfo >> 3;
-        int wireType = fieldInfo & 0x7;
-        
-        if (wireType == 2) { // Length-delimited
-            uint64_t length = decodeVarint(ptr, remaining);
-            
-            if (remaining >= length) {
-                if (fieldNumber == 1) { // packet
-                    envelope.packetData.assign(ptr, ptr + length);
-                    cout << "✓ 找到MeshPacket (" << length << " 字节)" << endl;
-                } else if (fieldNumber == 2) { // channel_id
-                    envelope.channelId.assign((char*)ptr, length);
-                    cout << "✓ Channel ID: " << envelope.channelId << endl;
-                } else if (fieldNumber == 3) { // gateway_id
-                    envelope.gatewayId.assign((char*)ptr, length);
-                    cout << "✓ Gateway ID: " << envelope.gatewayId << endl;
-                }
-                
-                ptr += length;
-                remaining -= length;
-            } else {
-                break;
-            }
-        } else {
-            break;
-        }
+    if (envelope.valid) {
+        cout << "✓ 找到MeshPacket (" << envelope.packetData.size() << " 字节)" << endl;
+    }
+    if (!envelope.channelId.empty()) {
+        cout << "✓ Channel ID: " << envelope.channelId << endl;
+    }
+    if (!envelope.gatewayId.empty()) {
+        cout << "✓ Gateway ID: " << envelope.gatewayId << endl;
     }
     
-    envelope.valid = !envelope.packetData.empty();
     return envelope;
 }
 
-// 解析MeshPacket
+// 解析MeshPacket (使用共享的schema解析器, 然后打印各字段)
 MeshPacket parseMeshPacket(const uint8_t* data, size_t length) {
-    MeshPacket packet;
-    const uint8_t* ptr = data;
-    size_t remaining = length;
+    MeshPacket packet = decodeMeshPacket(data, length);
     
     cout << "\n=== MeshPacket解析 ===" << endl;
-    
-    while (remaining > 0) {
-        uint64_t fieldInfo = decodeVarint(ptr, remaining);
-        int fieldNumber = fieldInfo >> 3;
-        int wireType = fieldInfo & 0x7;
-        
-        switch (fieldNumber) {
-            case 1: // from
-                if (wireType == 0) {
-                    packet.from = (uint32_t)decodeVarint(ptr, remaining);
-                    cout << "✓ From: 0x" << hex << packet.from << dec << " (!" << hex << packet.from << dec << ")" << endl;
-                }
-                break;
-                
-            case 2: // to  
-                if (wireType == 0) {
-                    packet.to = (uint32_t)decodeVarint(ptr, remaining);
-                    cout << "✓ To: 0x" << hex << packet.to << dec;
-                    if (packet.to == 0xFFFFFFFF) {
-                        cout << " (广播)";
-                    }
-                    cout << endl;
-                }
-                break;
-                
-            case 4: // encrypted
-                if (wireType == 2) {
-                    uint64_t length = decodeVarint(ptr, remaining);
-                    if (remaining >= length) {
-                        packet.encryptedData.assign(ptr, ptr + length);
-                        cout << "✓ 加密数据: " << length << " 字节" << endl;
-                        ptr += length;
-                        remaining -= length;
-                    }
-                }
-                break;
-                
-            case 6: // id
-                if (wireType == 1) { // fixed64
-                    if (remaining >= 8) {
-                        packet.id = *(uint64_t*)ptr;
-                        cout << "✓ ID: 0x" << hex << packet.id << dec << endl;
-                        ptr += 8;
-                        remaining -= 8;
-                    }
-                } else if (wireType == 0) { // varint
-                    packet.id = decodeVarint(ptr, remaining);
-                    cout << "✓ ID: 0x" << hex << packet.id << dec << endl;
-                }
-                break;
-                
-            case 7: // channel
-                if (wireType == 0) {
-                    packet.channel = (uint32_t)decodeVarint(ptr, remaining);
-                    cout << "✓ Channel: 0x" << hex << packet.channel << dec << endl;
-                }
-                break;
-                
-            case 8: // hop_limit
-                if (wireType == 0) {
-                    packet.hopLimit = (uint32_t)decodeVarint(ptr, remaining);
-                    cout << "✓ Hop Limit: " << packet.hopLimit << endl;
-                }
-                break;
-                
-            case 9: // hop_start
-                if (wireType == 0) {
-                    packet.hopStart = (uint32_t)decodeVarint(ptr, remaining);
-                    cout << "✓ Hop Start: " << packet.hopStart << endl;
-                }
-                break;
-                
-            case 10: // want_ack
-                if (wireType == 0) {
-                    packet.wantAck = decodeVarint(ptr, remaining) != 0;
-                    cout << "✓ Want ACK: " << (packet.wantAck ? "true" : "false") << endl;
-                }
-                break;
-                
-            default:
-                // 跳过未知字段
-                if (wireType == 0) {
-                    decodeVarint(ptr, remaining);
-                } else if (wireType == 2) {
-                    uint64_t length = decodeVarint(ptr, remaining);
-                    if (remaining >= length) {
-                        ptr += length;
-                        remaining -= length;
-                    }
-                } else if (wireType == 1) {
-                    if (remaining >= 8) {
-                        ptr += 8;
-                        remaining -= 8;
-                    }
-                } else if (wireType == 5) {
-                    if (remaining >= 4) {
-                        ptr += 4;
-                        remaining -= 4;
-                    }
-                }
-                break;
+    if (packet.has(MeshPacket::FROM)) {
+        cout << "✓ From: 0x" << hex << packet.from << dec << " (!" << hex << packet.from << dec << ")" << endl;
+    }
+    if (packet.has(MeshPacket::TO)) {
+        cout << "✓ To: 0x" << hex << packet.to << dec;
+        if (packet.to == 0xFFFFFFFF) {
+            cout << " (广播)";
         }
+        cout << endl;
+    }
+    if (packet.has(MeshPacket::CHANNEL)) {
+        cout << "✓ Channel: 0x" << hex << packet.channel << dec << endl;
+    }
+    if (packet.has(MeshPacket::DECODED)) {
+        cout << "✓ 明文数据: " << packet.decodedData.size() << " 字节" << endl;
+    }
+    if (packet.has(MeshPacket::ENCRYPTED)) {
+        cout << "✓ 加密数据: " << packet.encryptedData.size() << " 字节" << endl;
+    }
+    if (packet.has(MeshPacket::ID)) {
+        cout << "✓ ID: 0x" << hex << packet.id << dec << endl;
+    }
+    if (packet.has(MeshPacket::HOP_LIMIT)) {
+        cout << "✓ Hop Limit: " << packet.hopLimit << endl;
+    }
+    if (packet.has(MeshPacket::HOP_START)) {
+        cout << "✓ Hop Start: " << packet.hopStart << endl;
+    }
+    if (packet.has(MeshPacket::WANT_ACK)) {
+        cout << "✓ Want ACK: " << (packet.wantAck ? "true" : "false") << endl;
     }
     
-    packet.valid = true;
     return packet;
 }
 
@@ -331,10 +166,14 @@ int main() {
             // 解析MeshPacket
             MeshPacket packet = parseMeshPacket(envelope.packetData.data(), envelope.packetData.size());
             
-            if (!packet.valid) {
+            // 尾部字节异常或未知wire type时, 仍显示出错前已解析的字段
+            if (packet.present == 0) {
                 cout << "❌ MeshPacket解析失败！" << endl;
                 continue;
             }
+            if (!packet.valid) {
+                cout << "⚠️ MeshPacket不完整或格式异常, 以下结果只包含出错前已解析的字段" << endl;
+            }
             
             // 显示解析结果
             cout << "\n=== 解析结果总结 ===" << endl;
@@ -349,6 +188,15 @@ int main() {
             cout << "📍 网关: " << envelope.gatewayId << endl;
             cout << "📍 消息ID: 0x" << hex << packet.id << dec << endl;
             
+            // 未加密的数据包 (field 4)
+            if (packet.has(MeshPacket::DECODED)) {
+                DataMessage message = decodeDataMessage(packet.decodedData.data(), packet.decodedData.size());
+                cout << "📍 端口: " << message.portnum << endl;
+                if (message.portnum == PORT_TEXT_MESSAGE) {
+                    cout << "📍 文本: " << string(message.payload.begin(), message.payload.end()) << endl;
+                }
+            }
+            
             // 分析加密数据
             if (!packet.encryptedData.empty()) {
                 cout << "\n请输入预期的消息内容 (用于验证，可留空): ";